@@ -0,0 +1,330 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Report trends of benchmarks stored in the history (see --history)
+ *
+ * The last runs of every benchmark and of every timed parameters set are
+ * read. A change point is the split of the runs into older and newer ones,
+ * which moves the median the most compared to the noise of runs. A gradual
+ * drift is estimated by the Theil-Sen slope over all runs. The exit status
+ * is 1, if something got slower.
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tap_history.h"
+
+/** Runs at least in each part of a change */
+#define TAP_HISTORY_SEGMENT 3
+
+/** Standard deviation of normally distributed values per their MAD */
+#define TAP_HISTORY_MAD_SIGMA 1.4826
+
+/** Key of the history and its newest record */
+struct tap_history_key_s {
+	uint64_t offset;
+	tap_history_rec_t rec;
+};
+
+/** Runs considered */
+static unsigned long tap_history_runs = 30;
+
+/** Noise of runs, which a change must exceed */
+static double tap_history_sigmas = 5;
+
+/** Smallest change and drift reported in percents */
+static double tap_history_change = 5;
+static double tap_history_drift = 10;
+
+static int tap_history_key_cmp(const void *a, const void *b)
+{
+	const tap_history_rec_t *x = &((const struct tap_history_key_s *)a)->rec;
+	const tap_history_rec_t *y = &((const struct tap_history_key_s *)b)->rec;
+	int rtn;
+
+	if (x->kind != y->kind) {
+		return x->kind < y->kind ? -1 : 1;
+	}
+
+	rtn = strcmp(x->name, y->name);
+	if (rtn) {
+		return rtn;
+	}
+
+	return x->round < y->round ? -1 : x->round > y->round;
+}
+
+static int tap_history_double_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/** Median of values, tmp is a buffer of the same size */
+static double tap_history_median(const double *vals, unsigned long n, 
+		double *tmp)
+{
+	memcpy(tmp, vals, n * sizeof *tmp);
+	qsort(tmp, n, sizeof *tmp, tap_history_double_cmp);
+
+	return n % 2 ? tmp[n / 2] : (tmp[n / 2 - 1] + tmp[n / 2]) / 2;
+}
+
+/** Find the change point, if it's significant
+ * @param x - values from the oldest one
+ * @param before, after - medians before and after the change
+ *
+ * The change point minimizes the sum of absolute deviations from medians of
+ * both parts. It's significant, if the medians differ by the given number of
+ * sigmas estimated from the median absolute deviation.
+ *
+ * @return index of the first value after the change or 0 if there isn't
+ *         a significant change
+ */
+static unsigned long tap_history_change_point(const double *x, 
+		unsigned long n, double *before, double *after, double *tmp)
+{
+	double *dev = tmp + n;
+	double l, r, cost, best = HUGE_VAL, sigma;
+	unsigned long i, k, rtn = 0;
+
+	for (k = TAP_HISTORY_SEGMENT; k + TAP_HISTORY_SEGMENT <= n; k++) {
+		l = tap_history_median(x, k, tmp);
+		r = tap_history_median(x + k, n - k, tmp);
+
+		for (cost = 0, i = 0; i < n; i++) {
+			cost += fabs(x[i] - (i < k ? l : r));
+		}
+
+		if (cost < best) {
+			best = cost;
+			rtn = k;
+			*before = l;
+			*after = r;
+		}
+	}
+
+	if (rtn == 0 || fabs(*after - *before) * 100 < 
+			tap_history_change * *before) {
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		dev[i] = fabs(x[i] - (i < rtn ? *before : *after));
+	}
+	sigma = TAP_HISTORY_MAD_SIGMA * tap_history_median(dev, n, tmp);
+
+	return fabs(*after - *before) >= tap_history_sigmas * sigma ? rtn : 0;
+}
+
+/** Relative drift over all values in percents by the Theil-Sen estimator */
+static double tap_history_trend(const double *x, unsigned long n, 
+		double *tmp)
+{
+	double *slopes, slope, median;
+	unsigned long i, j, m = 0;
+
+	if (n < 2 * TAP_HISTORY_SEGMENT) {
+		return 0;
+	}
+
+	slopes = malloc(n * (n - 1) / 2 * sizeof *slopes);
+	if (slopes == NULL) {
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		for (j = i + 1; j < n; j++) {
+			slopes[m++] = (x[j] - x[i]) / (j - i);
+		}
+	}
+
+	/* Medians are computed in place, the order isn't needed anymore */
+	qsort(slopes, m, sizeof *slopes, tap_history_double_cmp);
+	slope = m % 2 ? slopes[m / 2] : (slopes[m / 2 - 1] + slopes[m / 2]) / 2;
+	free(slopes);
+
+	median = tap_history_median(x, n, tmp);
+
+	return median > 0 ? slope * (n - 1) * 100 / median : 0;
+}
+
+static void tap_history_print_run(const tap_history_rec_t *rec)
+{
+	time_t run = rec->run / 1000000000ULL;
+	char date[32];
+	uint32_t i;
+
+	strftime(date, sizeof date, "%Y-%m-%d %H:%M:%S", localtime(&run));
+	printf("%s, build ", date);
+	for (i = 0; i < rec->build_id_len && i < TAP_HISTORY_BUILD_ID; i++) {
+		printf("%02x", rec->build_id[i]);
+	}
+}
+
+/** Report one key, return 1 if it got slower */
+static int tap_history_report(tap_history_t *history, 
+		const struct tap_history_key_s *key)
+{
+	tap_history_rec_t *recs;
+	double *x, before, after, drift;
+	unsigned long i, n, k;
+	uint64_t offset;
+	int rtn = 0;
+
+	recs = malloc(tap_history_runs * sizeof *recs);
+	x = malloc(3 * tap_history_runs * sizeof *x);
+	if (recs == NULL || x == NULL) {
+		free(recs);
+		free(x);
+		return 0;
+	}
+
+	/* Records are linked from the newest one */
+	n = tap_history_runs;
+	for (offset = key->offset; offset != TAP_HISTORY_NONE && n > 0; 
+			offset = recs[n].prev) {
+		if (tap_history_read(history, offset, &recs[--n])) {
+			n++;
+			break;
+		}
+	}
+	memmove(recs, recs + n, (tap_history_runs - n) * sizeof *recs);
+	n = tap_history_runs - n;
+
+	for (i = 0; i < n; i++) {
+		x[i] = recs[i].median;
+	}
+
+	if (key->rec.kind == TAP_HISTORY_ROUND) {
+		printf("round %lld", (long long)key->rec.round);
+	} else {
+		printf("%s", key->rec.name);
+		if (key->rec.round >= 0) {
+			printf(" [round %lld]", (long long)key->rec.round);
+		}
+	}
+	printf(": %lu runs, median %.2f ns\n", n, x[n - 1]);
+
+	k = tap_history_change_point(x, n, &before, &after, x + n);
+	if (k) {
+		printf("    change at run %lu (", k + 1);
+		tap_history_print_run(&recs[k]);
+		printf("): %.2f ns -> %.2f ns (%+.1f%%)\n", before, after, 
+				(after - before) * 100 / before);
+		rtn = after > before;
+	} else {
+		drift = tap_history_trend(x, n, x + n);
+		if (fabs(drift) >= tap_history_drift) {
+			printf("    drift %+.1f%% over %lu runs\n", drift, n);
+			rtn = drift > 0;
+		}
+	}
+
+	free(recs);
+	free(x);
+
+	return rtn;
+}
+
+int main(int argc, char *argv[])
+{
+	struct tap_history_key_s *keys;
+	tap_history_bucket_t bucket;
+	tap_history_t history;
+	unsigned long nkeys = 0;
+	uint64_t i;
+	int opt, rtn = 0;
+
+	while ((opt = getopt(argc, argv, "n:s:c:d:h")) != -1) {
+		switch (opt) {
+			case 'n':
+				tap_history_runs = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				tap_history_sigmas = strtod(optarg, NULL);
+				break;
+			case 'c':
+				tap_history_change = strtod(optarg, NULL);
+				break;
+			case 'd':
+				tap_history_drift = strtod(optarg, NULL);
+				break;
+			default:
+				optind = argc;
+				break;
+		}
+	}
+
+	if (optind + 1 != argc || tap_history_runs < 1) {
+		fprintf(stderr, "Usage: %s [-n runs] [-s sigmas] [-c percent] "
+				"[-d percent] FILE\n"
+				"Report change points and drifts of the last runs "
+				"(default: 30) in the history.\n"
+				"  -s ... noise of runs a change must exceed "
+				"(default: 5)\n"
+				"  -c ... smallest change reported (default: 5)\n"
+				"  -d ... smallest drift reported (default: 10)\n",
+				argv[0]);
+		return 2;
+	}
+
+	if (tap_history_open(&history, argv[optind], 0)) {
+		perror(argv[optind]);
+		return 2;
+	}
+
+	keys = malloc(history.idx.keys * sizeof *keys);
+	if (keys == NULL && history.idx.keys) {
+		perror("malloc");
+		return 2;
+	}
+
+	for (i = 0; i < history.idx.size && nkeys < history.idx.keys; i++) {
+		if (tap_history_bucket(&history, i, &bucket) == 0 && 
+		    bucket.offset && tap_history_read(&history, 
+				bucket.offset - 1, &keys[nkeys].rec) == 0) {
+			keys[nkeys++].offset = bucket.offset - 1;
+		}
+	}
+
+	qsort(keys, nkeys, sizeof *keys, tap_history_key_cmp);
+
+	for (i = 0; i < nkeys; i++) {
+		rtn |= tap_history_report(&history, &keys[i]);
+	}
+
+	free(keys);
+	tap_history_close(&history);
+
+	return rtn;
+}
@@ -0,0 +1,135 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Merge TAP streams of shards (see --shard) into one stream
+ *
+ * Tests are renumbered in the order of input files, other lines are copied
+ * unchanged. The plan is the sum of plans of inputs and it's printed at the
+ * end. Inputs without a plan contribute by the number of their tests.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+
+/** Number of tests written so far */
+static unsigned long tap_merge_tests = 0;
+
+/** Sum of plans of inputs */
+static unsigned long tap_merge_plan = 0;
+
+/** Renumber the test on the line, return 0 if it isn't a test line */
+static int tap_merge_test(const char *line)
+{
+	const char *rest;
+	int len;
+
+	if (0 == strncmp(line, "ok", 2)) {
+		len = 2;
+	} else if (0 == strncmp(line, "not ok", 6)) {
+		len = 6;
+	} else {
+		return 0;
+	}
+
+	if (line[len] != ' ' && line[len] != '\n' && line[len] != '\0') {
+		return 0;
+	}
+
+	for (rest = line + len; *rest == ' '; rest++);
+	if (isdigit(*rest)) {
+		while (isdigit(*rest)) {
+			rest++;
+		}
+	} else {
+		rest = line + len;
+	}
+
+	printf("%.*s %lu%s", len, line, ++tap_merge_tests, rest);
+	return 1;
+}
+
+/** Copy the stream to stdout, return -1 on error */
+static int tap_merge_file(const char *name)
+{
+	unsigned long plan = 0, tests = 0;
+	int have_plan = 0;
+	size_t size = 0;
+	char *line = NULL;
+	FILE *f;
+
+	if (0 == strcmp(name, "-")) {
+		f = stdin;
+	} else if (NULL == (f = fopen(name, "r"))) {
+		perror(name);
+		return -1;
+	}
+
+	while (getline(&line, &size, f) > 0) {
+		if (1 == sscanf(line, "1..%lu", &plan)) {
+			have_plan = 1;
+		} else if (0 == strncmp(line, "TAP version", 11)) {
+			continue;
+		} else if (tap_merge_test(line)) {
+			tests++;
+		} else {
+			fputs(line, stdout);
+		}
+	}
+
+	tap_merge_plan += have_plan ? plan : tests;
+
+	free(line);
+	if (f != stdin) {
+		fclose(f);
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int rtn = 0;
+	int i;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s FILE...\n"
+				"Merge TAP outputs of shards, '-' is stdin.\n", 
+				argv[0]);
+		return 2;
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (tap_merge_file(argv[i])) {
+			rtn = 1;
+		}
+	}
+
+	printf("1..%lu\n", tap_merge_plan);
+
+	return rtn;
+}
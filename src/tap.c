@@ -30,32 +30,39 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/mman.h>
 #include <errno.h>
 
 
+#include <sched.h>
+#include <sys/uio.h>
+
 #ifdef HAVE_LIBPTHREAD
-#ifdef __linux__
-#define __USE_GNU
-#include <pthread.h>
-#ifndef PTHREAD_MUTEX_RECURSIVE
-#define PTHREAD_MUTEX_RECURSIVE PTHREAD_MUTEX_RECURSIVE_NP
-#endif
-#else
 #include <pthread.h>
-#endif // __linux__
-#define LOCK pthread_mutex_lock(&tap_shm->lock);
-#define UNLOCK pthread_mutex_unlock(&tap_shm->lock);
-#else // HAVE_LIBPTHREAD
-#define LOCK
-#define UNLOCK
 #endif // HAVE_LIBPTHREAD
 
+#ifdef HAVE_SYS_SINGLE_THREADED_H
+#include <sys/single_threaded.h>
+#endif // HAVE_SYS_SINGLE_THREADED_H
+
+#define LOCK tap_lock(0)
+#define UNLOCK tap_unlock()
+
 #define INIT do { if (initialized == 0) { tap_implicit_init(); } } while (0)
 
 #include "tap.h"
 #include "tap_main.h"
+#include "tap_params.h"
 #include "tap_skip_todo.h"
+#include "tap_output.h"
+#include "tap_capture.h"
+#include "tap_round.h"
+#include "tap_bench.h"
+#include "tap_perf.h"
+#include "tap_repeat.h"
+#include "tap_rusage.h"
 
 /** True, if the library was already initialized */
 static int initialized = 0;
@@ -74,172 +81,633 @@ static void tap_implicit_init(void)
 #endif
 }
 
+/** Increment of the ticket part of tap_shm_s.claim */
+#define TAP_TICKET (1ULL << 32)
 
 struct tap_shm_s {
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_t lock;
-#endif
+	/* Output ticket in upper and number of tests that have been run in
+	   lower 32 bits, so both can be claimed by a single atomic add */
+	unsigned long long claim;
+	unsigned int served;     /* Ticket, which is allowed to output */
 	int no_plan;
 	int skip_all;
 	int have_plan;
-	unsigned int test_count; /* Number of tests that have been run */
 	unsigned int e_tests;    /* Expected number of tests to run */
 	unsigned int failures;   /* Number of tests that failed */
 	int test_died;
 	int main_pid;
+	unsigned int run_first;  /* First test of not reported passed tests */
+	unsigned int run_last;   /* Last one, 0 if there are none */
+	unsigned int lines;      /* Reported lines with TAP_FLAGS_COMPRESS_STRICT */
 };
 
-struct tap_shm_s tap_shm_nofork = {
-#ifdef HAVE_LIBPTHREAD
-#ifdef __linux__
-	.lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,
-#else
-	.lock = PTHREAD_MUTEX_INITIALIZER,
-#endif
-#endif
-};
+struct tap_shm_s tap_shm_nofork;
 
 static struct tap_shm_s *tap_shm = &tap_shm_nofork;
 
+int tap_fast_inhibit = 1;
+
+unsigned int tap_fast_passes;
+
+/** How many times the current thread entered tap_lock() */
+static __thread int tap_lock_depth;
+
+/** Ticket of the current thread, valid if tap_lock_depth is not 0 */
+static __thread unsigned int tap_lock_ticket;
+
+/** True, once a child sharing tap_shm was forked with TAP_FLAGS_FORK */
+static int tap_lock_shared;
+
+/** True, if no other thread or process can take the lock */
+static inline int tap_lock_single(void)
+{
+#ifdef HAVE_SYS_SINGLE_THREADED_H
+	return __libc_single_threaded && !tap_lock_shared;
+#else
+	return 0;
+#endif
+}
+
 static void _expected_tests(unsigned int);
 static void _cleanup(void);
 
 extern unsigned long tap_flags;
 
+/** Number of tests that have been run */
+static inline unsigned int tap_test_count(void)
+{
+	return (unsigned int)__atomic_load_n(&tap_shm->claim, __ATOMIC_ACQUIRE);
+}
+
+/** Number of the next result line
+ * @param number - number of the test
+ *
+ * Lines are numbered by tests, unless runs of tests are collapsed into one
+ * line with TAP_FLAGS_COMPRESS_STRICT.
+ */
+static unsigned int tap_line_number(unsigned int number)
+{
+	if (tap_flags & TAP_FLAGS_COMPRESS_STRICT) {
+		return ++tap_shm->lines;
+	}
+
+	return number;
+}
+
+/** Number of lines reported for test_count tests */
+static unsigned int tap_line_count(unsigned int test_count)
+{
+	if (tap_flags & TAP_FLAGS_COMPRESS_STRICT) {
+		return tap_shm->lines;
+	}
+
+	return test_count;
+}
+
+/** Add passed tests to the current run, called with the lock held */
+static void tap_run_add(unsigned int first, unsigned int count)
+{
+	if (tap_shm->run_last == 0) {
+		tap_shm->run_first = first;
+	}
+	tap_shm->run_last = first + count - 1;
+}
+
+/** Report the current run of passed tests, called with the lock held */
+static void tap_run_flush(void)
+{
+	char buf[64];
+	int len;
+
+	if (tap_shm->run_last == 0) {
+		return;
+	}
+
+	if (tap_flags & TAP_FLAGS_COMPRESS_STRICT) {
+		if (tap_shm->run_first == tap_shm->run_last) {
+			len = snprintf(buf, sizeof buf, 
+					"ok %u - test %u passed\n",
+					++tap_shm->lines, tap_shm->run_first);
+		} else {
+			len = snprintf(buf, sizeof buf, 
+					"ok %u - tests %u..%u passed\n",
+					++tap_shm->lines, tap_shm->run_first, 
+					tap_shm->run_last);
+		}
+	} else {
+		len = snprintf(buf, sizeof buf, "# ok %u..%u passed\n",
+				tap_shm->run_first, tap_shm->run_last);
+	}
+
+	tap_shm->run_last = 0;
+	tap_output_write(STDOUT_FILENO, buf, len);
+}
+
+/** Report tests, which passed through the fast path
+ * @param count - number of tests run before them
+ * @param passes - how many of them
+ */
+static void tap_fast_report(unsigned int count, unsigned int passes)
+{
+	tap_line_t out;
+
+	if (tap_flags & TAP_FLAGS_COMPRESS) {
+		tap_run_add(count + 1, passes);
+		return;
+	}
+
+	tap_line_init(&out);
+
+	while (passes--) {
+		tap_line_printf(&out, "ok %u\n", tap_line_number(++count));
+		if (out.len > sizeof out.local - 16) {
+			tap_output_line(STDOUT_FILENO, &out);
+		}
+	}
+
+	tap_output_line(STDOUT_FILENO, &out);
+	tap_line_free(&out);
+}
+
+/** Claim test numbers and wait until it's our turn to produce the output
+ * @param tests - how many test numbers to claim
+ *
+ * The lock is a ticket taken together with the test numbers, so results are
+ * written in the order of their numbers. An uncontended lock costs just one
+ * atomic add and the lock is recursive. Until the first thread is created
+ * or a child is forked with TAP_FLAGS_FORK the ticket is taken without any
+ * atomic operation.
+ *
+ * Waiters spin until their ticket is served. The lock isn't robust, its
+ * holder isn't tracked, so a process forked with TAP_FLAGS_FORK, which dies
+ * or is killed while it holds the ticket (e.g. while it writes a result),
+ * stalls every other process of the test forever. A harness timeout is the
+ * only way out then.
+ *
+ * Tests passed through the fast path are numbered and reported first.
+ *
+ * @return number of tests run before the claimed ones
+ */
+static unsigned int tap_lock(unsigned int tests)
+{
+	unsigned long long claim;
+	unsigned int passes = 0;
+
+	if (__atomic_load_n(&tap_fast_passes, __ATOMIC_RELAXED)) {
+		passes = __atomic_exchange_n(&tap_fast_passes, 0, 
+				__ATOMIC_RELAXED);
+	}
+
+	if (tap_lock_single()) {
+		claim = tap_shm->claim;
+		tap_shm->claim = claim + passes + tests + 
+				(tap_lock_depth ? 0 : TAP_TICKET);
+		if (tap_lock_depth++ == 0) {
+			tap_lock_ticket = claim >> 32;
+		}
+	} else if (tap_lock_depth++) {
+		claim = __atomic_fetch_add(&tap_shm->claim, passes + tests, 
+				__ATOMIC_RELAXED);
+	} else {
+		claim = __atomic_fetch_add(&tap_shm->claim, 
+				TAP_TICKET | (passes + tests), __ATOMIC_RELAXED);
+		tap_lock_ticket = claim >> 32;
+
+		while (__atomic_load_n(&tap_shm->served, __ATOMIC_ACQUIRE) != 
+				tap_lock_ticket) {
+			sched_yield();
+		}
+	}
+
+	if (passes) {
+		tap_fast_report((unsigned int)claim, passes);
+	}
+
+	return (unsigned int)claim + passes;
+}
+
+/** Let the next ticket produce the output */
+static void tap_unlock(void)
+{
+	if (--tap_lock_depth == 0) {
+		__atomic_store_n(&tap_shm->served, tap_lock_ticket + 1,
+				__ATOMIC_RELEASE);
+	}
+}
+
+/** Write the output, or capture it if the current thread captures it */
+static void tap_write(int fd, const char *buf, size_t len)
+{
+	if (tap_capture) {
+		tap_capture_put(tap_capture, 
+				fd == STDOUT_FILENO ? TAP_REC_OUT : TAP_REC_ERR,
+				buf, len);
+	} else {
+		tap_output_write(fd, buf, len);
+	}
+}
+
+/** Write a result line, called with the lock held
+ * @param ok - true if the test passed
+ * @param number - number of the test
+ * @param tail - rest of the line after the test number
+ * @param len - length of the tail
+ */
+static void tap_result_write(int ok, unsigned int number, const char *tail, 
+		size_t len)
+{
+	char head[32];
+	struct iovec iov[2];
+
+	iov[0].iov_base = head;
+	iov[0].iov_len = snprintf(head, sizeof head, "%sok %u", 
+			ok ? "" : "not ", tap_line_number(number));
+	iov[1].iov_base = (char*)tail;
+	iov[1].iov_len = len;
+
+	tap_output_writev(STDOUT_FILENO, iov, 2);
+}
+
+/** Write the output captured by a worker thread and number its tests */
+void tap_capture_emit(const tap_capture_t *capture)
+{
+	const char *data;
+	unsigned int number;
+	size_t pos = 0;
+	size_t len;
+	tap_rec_t kind;
+
+	LOCK;
+
+	while (NULL != (data = tap_capture_next(capture, &pos, &kind, &len))) {
+		switch (kind) {
+			case TAP_REC_OUT:
+				tap_run_flush();
+				tap_output_write(STDOUT_FILENO, data, len);
+				break;
+			case TAP_REC_ERR:
+				tap_output_write(STDERR_FILENO, data, len);
+				break;
+			case TAP_REC_PASS:
+				tap_run_add(tap_lock(1) + 1, 1);
+				UNLOCK;
+				break;
+			case TAP_REC_NOT_OK:
+				__atomic_add_fetch(&tap_shm->failures, 1, 
+						__ATOMIC_RELAXED);
+				/* fall through */
+			case TAP_REC_OK:
+			case TAP_REC_TODO:
+				number = tap_lock(1) + 1;
+				tap_run_flush();
+				tap_result_write(kind == TAP_REC_OK, number, 
+						data, len);
+				UNLOCK;
+				break;
+			case TAP_REC_BAIL:
+				tap_run_flush();
+				tap_output_write(STDOUT_FILENO, data, len);
+				tap_output_flush();
+				exit(255);
+			case TAP_REC_END:
+				break;
+		}
+	}
+
+	UNLOCK;
+}
+
+/** Don't let the child inherit the queued output or a half written line */
+static void tap_fork_prepare(void)
+{
+	LOCK;
+	tap_output_flush();
+}
+
+static void tap_fork_done(void)
+{
+	UNLOCK;
+}
+
+static void tap_fork_child(void)
+{
+	tap_output_fork_child();
+	UNLOCK;
+}
+
+/** Forked processes share the lock with TAP_FLAGS_FORK */
+static void tap_fork_share(void)
+{
+	tap_lock_shared = 1;
+}
+
+/** Values compared by a test, they are formatted only if they get reported */
+typedef struct tap_values_s {
+	/** Append YAMLish actual and expected lines to out */
+	void (*format)(const struct tap_values_s *values, tap_line_t *out);
+	union {
+		long long s;
+		unsigned long long u;
+		const char *str;
+		const void *ptr;
+		double d;
+	} got, expected;
+	/** Comparison operator, NULL if there is no expected value */
+	const char *op;
+	/** True, if the values are reported even if the test passed */
+	int always;
+} tap_values_t;
+
+static void tap_values_charp(const tap_values_t *values, tap_line_t *out)
+{
+	tap_line_printf(out, "  actual: %s\n", values->got.str);
+	if (values->op) {
+		tap_line_printf(out, "  expected: %s\n", values->expected.str);
+	}
+}
+
+static void tap_values_longlong(const tap_values_t *values, tap_line_t *out)
+{
+	tap_line_printf(out, "  actual: %lld\n", values->got.s);
+	if (values->op) {
+		tap_line_printf(out, "  expected: %lld\n", values->expected.s);
+	}
+}
+
+static void tap_values_ulonglong(const tap_values_t *values, tap_line_t *out)
+{
+	tap_line_printf(out, "  actual: %llu\n", values->got.u);
+	if (values->op) {
+		tap_line_printf(out, "  expected: %llu\n", values->expected.u);
+	}
+}
+
+static void tap_values_max(const tap_values_t *values, tap_line_t *out)
+{
+	tap_line_printf(out, "  actual: %llu\n", values->got.u);
+	tap_line_printf(out, "  expected: %s %llu\n", values->op, 
+			values->expected.u);
+}
+
+static void tap_values_cmp(const tap_values_t *values, tap_line_t *out)
+{
+	tap_line_printf(out, "  actual: 0x%llx\n", values->got.s);
+	tap_line_printf(out, "  expected: %s 0x%llx\n", values->op, 
+			values->expected.s);
+}
+
+static void tap_values_bench(const tap_values_t *values, tap_line_t *out)
+{
+	const tap_bench_stats_t *stats = values->got.ptr;
+
+	tap_line_printf(out, "  samples: %u\n", stats->samples);
+	tap_line_printf(out, "  iterations: %lu\n", stats->iterations);
+	tap_line_printf(out, "  min_ns: %.2f\n", stats->min);
+	tap_line_printf(out, "  median_ns: %.2f\n", stats->median);
+	tap_line_printf(out, "  mean_ns: %.2f\n", stats->mean);
+	tap_line_printf(out, "  p99_ns: %.2f\n", stats->p99);
+	tap_line_printf(out, "  stddev_ns: %.2f\n", stats->stddev);
+	tap_line_printf(out, "  mad_ns: %.2f\n", stats->mad);
+	if (tap_flags & TAP_FLAGS_PERF) {
+		tap_perf_format(out, "perf_per_iteration", stats->perf, 2);
+	}
+}
+
+static void tap_values_repeat(const tap_values_t *values, tap_line_t *out)
+{
+	const tap_repeat_stats_t *stats = values->got.ptr;
+
+	tap_line_printf(out, "  repetitions: %u\n", stats->repetitions);
+	tap_line_printf(out, "  failures: %u\n", stats->failures);
+	tap_line_printf(out, "  flake_rate: %.3f\n", 
+			(double)stats->failures / stats->repetitions);
+	tap_line_printf(out, "  flake_rate_ci95: [%.3f, %.3f]\n", 
+			stats->flake_low, stats->flake_high);
+	tap_line_printf(out, "  duration_min_ns: %.0f\n", stats->min);
+	tap_line_printf(out, "  duration_median_ns: %.0f\n", stats->median);
+	tap_line_printf(out, "  duration_mean_ns: %.0f\n", stats->mean);
+	tap_line_printf(out, "  duration_p95_ns: %.0f\n", stats->p95);
+	tap_line_printf(out, "  duration_stddev_ns: %.0f\n", stats->stddev);
+	tap_line_printf(out, "  duration_mean_ci95_ns: [%.0f, %.0f]\n", 
+			stats->ci_low, stats->ci_high);
+}
+
+static void tap_values_double(const tap_values_t *values, tap_line_t *out)
+{
+	tap_line_printf(out, "  actual: %.2f\n", values->got.d);
+	tap_line_printf(out, "  expected: %s %.2f\n", values->op, 
+			values->expected.d);
+}
+
 /** Generate a test results
  * @param ok - true if the test passed
+ * @param values - compared values or NULL
  * @param func - name of caller
  * @param file - file name of caller
  * @param line - line from which we ware called
  * @param test_name - format string generating the test name
  * @param ap - arguments for format
  *
+ * Everything except the test number is formatted before the number is
+ * claimed, so the lock is held only while the record is written out.
+ *
  * @return 1 if the test passed
  */
 static unsigned int _vgen_result(int ok, const char *condition, 
-		const char *actual, const char *expected,
+		const tap_values_t *values,
 		const char *func, const char *file, unsigned int line, 
 		const char *test_name, va_list ap)
 {
-	char *local_test_name = NULL;
 	char *c;
 	int name_is_digits;
 	int old_errno = errno;
 	int print_flags = 0;
+	int always = values != NULL && values->always;
 	const char *todo;
+	unsigned int number;
+	unsigned long long duration, since_start;
+	tap_perf_counts_t perf;
+	double perf_vals[TAP_PERF_EVENTS];
+	tap_rusage_t usage;
+	size_t tail, yaml;
+	tap_line_t name;
+	tap_line_t out;
+
+	if (tap_flags & TAP_FLAGS_TIMING) {
+		tap_round_timing(&duration, &since_start);
+	}
+	if (tap_flags & TAP_FLAGS_PERF) {
+		tap_perf_test(&perf);
+	}
+	if (tap_flags & TAP_FLAGS_RUSAGE) {
+		tap_rusage_test(&usage);
+	}
 
-	LOCK;
+	tap_line_init(&name);
+	tap_line_init(&out);
 
-	if (tap_flags & TAP_FLAGS_TRACE) {
-		printf("# Trace: %s %s:%d\n", func, file, line);
+	if ((tap_flags & TAP_FLAGS_TRACE) && file) {
+		tap_line_printf(&out, "# Trace: %s %s:%d\n", func, file, line);
 	}
 
 	todo = tap_todo_msg();
 
-	tap_shm->test_count++;
-	if (!ok && !todo) {
-		tap_shm->failures++;
+	/* Passed tests are just counted, if they are compressed */
+	if (ok && !todo && !always && (tap_flags & TAP_FLAGS_COMPRESS) && 
+	    !(tap_flags & (TAP_FLAGS_TRACE | TAP_FLAGS_TIMING_PASS))) {
+		if (tap_capture) {
+			tap_capture_put(tap_capture, TAP_REC_PASS, NULL, 0);
+		} else {
+			tap_run_add(tap_lock(1) + 1, 1);
+			UNLOCK;
+		}
+		tap_line_free(&out);
+		errno = old_errno;
+		return 1;
 	}
 
 	/* Start by taking the test name and performing any printf()
-	   expansions on it */
+	   expansions on it. It's formatted on the stack, unless it's 
+	   too long */
 	if (test_name != NULL && *test_name < 10 && *test_name != 0) {
 		print_flags = *(test_name++);
 	}
 
 	if (test_name != NULL && *test_name != 0) {
-		if (vasprintf(&local_test_name, test_name, ap) < 0) {
-			local_test_name = NULL;
-		}
+		tap_line_vprintf(&name, test_name, ap);
 	} else if (condition != NULL && *condition != 0) {
-		if (asprintf(&local_test_name, "%s", condition) < 0) {
-			local_test_name = NULL;
-		}
+		tap_line_puts(&name, condition);
 	} else {
-		if (asprintf(&local_test_name, "%s:%d", func, line) < 0) {
-			local_test_name = NULL;
-		}
+		tap_line_printf(&name, "%s:%d", func, line);
 	}
 
 	/* Make sure the test name contains more than digits
 	   and spaces.  Emit an error message and exit if it
 	   does */
-	if (local_test_name) {
-		name_is_digits = 1;
-		for (c = local_test_name; *c != '\0'; c++) {
-			if (!isdigit(*c) && !isspace(*c)) {
-				name_is_digits = 0;
-				break;
-			}
+	name_is_digits = 1;
+	for (c = name.buf; *c != '\0'; c++) {
+		if (!isdigit(*c) && !isspace(*c)) {
+			name_is_digits = 0;
+			break;
 		}
+	}
 
-		if (name_is_digits) {
-			diag("    You named your test '%s'.  You shouldn't use numbers for your test names.", local_test_name);
-			diag("    Very confusing.");
-		}
+	if (name_is_digits) {
+		diag("    You named your test '%s'.  You shouldn't use numbers for your test names.", name.buf);
+		diag("    Very confusing.");
 	}
 
-	printf("%sok %d", ok ? "" : "not ", tap_shm->test_count);
+	/* The line is composed from the head with the test number and the
+	   tail, which is prepared in advance after the optional trace */
+	tail = out.len;
 
 	/* Print the test name, escaping any '#' characters it
 	   might contain */
-	if (local_test_name != NULL) {
-		printf(" - ");
-		for(c = local_test_name; *c != '\0'; c++) {
-			if(*c == '#')
-				fputc('\\', stdout);
-			fputc((int)*c, stdout);
-		}
+	tap_line_puts(&out, " - ");
+	for(c = name.buf; *c != '\0'; c++) {
+		if(*c == '#')
+			tap_line_putc(&out, '\\');
+		tap_line_putc(&out, *c);
 	}
 
 	if (!ok && (tap_flags & TAP_FLAGS_ERRNO)) {
-		printf(" # ERRNO: %d '%s'", old_errno, strerror(old_errno));
+		tap_line_printf(&out, " # ERRNO: %d '%s'", old_errno, strerror(old_errno));
 	}
 
 	if (todo) {
-		printf(" # TODO %s", todo);
+		tap_line_printf(&out, " # TODO %s", todo);
 	}
 
-	printf("\n");
+	tap_line_putc(&out, '\n');
+	yaml = out.len;
 
-	if (!ok) {
-		if (getenv("HARNESS_ACTIVE") != NULL) {
-			fputs("\n", stderr);
+	if (always || ((!ok || (tap_flags & TAP_FLAGS_TIMING_PASS)) && 
+	    (tap_flags & TAP_FLAGS_YAMLISH))) {
+		tap_line_puts(&out, "  ---\n");
+		if (test_name && test_name[0]) {
+			tap_line_printf(&out, "  name: %s\n", name.buf);
+		}
+		if (!ok && condition) {
+			tap_line_printf(&out, "  message: Condition '%s' evaluated to false\n", condition);
+		}
+		if (file) {
+			tap_line_printf(&out, "  file: %s\n", file);
+			tap_line_printf(&out, "  line: %d\n", line);
+		}
+		if (!ok) {
+			tap_line_printf(&out, "  severity: %s\n", todo ? "todo" : "fail");
+		}
+		if ((!ok || always) && values != NULL) { 
+			values->format(values, &out);
+		}
+		if (tap_flags & TAP_FLAGS_TIMING) {
+			tap_line_printf(&out, "  duration_ns: %llu\n", duration);
+			tap_line_printf(&out, "  since_start_ns: %llu\n", 
+					since_start);
+		}
+		if (tap_flags & TAP_FLAGS_PERF) {
+			tap_perf_values(perf_vals, &perf, 1);
+			tap_perf_format(&out, "perf", perf_vals, 0);
+		}
+		if (tap_flags & TAP_FLAGS_RUSAGE) {
+			tap_rusage_format(&out, &usage);
 		}
+		tap_line_puts(&out, "  ...\n");
+	}
 
-		if (tap_flags & TAP_FLAGS_YAMLISH) {
-			printf("  ---\n");
-			if (test_name && test_name[0]) {
-				printf("  name: %s\n", test_name);
-			}
-			if (condition) {
-				printf("  message: Condition '%s' evaluated to false\n", condition);
-			}
-			printf("  file: %s\n", file);
-			printf("  line: %d\n", line);
-			printf("  severity: %s\n", todo ? "todo" : "fail");
-			if (actual != NULL) { 
-				printf("  actual: %s\n", actual);
-			}
-			if (expected != NULL) { 
-				printf("  expected: %s\n", expected);
-			}
-			printf("  ...\n");
-		} else {
+	/* Captured tests are numbered and counted, when the capture is 
+	   emitted */
+	if (tap_capture) {
+		if (tail) {
+			tap_capture_put(tap_capture, TAP_REC_OUT, out.buf, tail);
+		}
+		tap_capture_put(tap_capture, ok ? TAP_REC_OK : 
+				todo ? TAP_REC_TODO : TAP_REC_NOT_OK, 
+				out.buf + tail, yaml - tail);
+	} else {
+		if (!ok && !todo) {
+			__atomic_add_fetch(&tap_shm->failures, 1, 
+					__ATOMIC_RELAXED);
+		}
+
+		number = tap_lock(1) + 1;
+		tap_run_flush();
+
+		if (tail) {
+			tap_output_write(STDOUT_FILENO, out.buf, tail);
+		}
+		tap_result_write(ok, number, out.buf + tail, yaml - tail);
+	}
+
+	/* The harness gets the empty line between the result and its 
+	   YAMLish block */
+	if (!ok && getenv("HARNESS_ACTIVE") != NULL) {
+		tap_write(STDERR_FILENO, "\n", 1);
+	}
+	if (yaml < out.len) {
+		tap_write(STDOUT_FILENO, out.buf + yaml, out.len - yaml);
+	}
+
+	if (!ok) {
+		if (!(tap_flags & TAP_FLAGS_YAMLISH) && file) {
 			diag("    Failed %stest in %s at line %d", 
 					todo ? "(TODO) " : "", file, line);
 			if (test_name && condition) {
 				diag("    Condition: %s", condition);
 			}
 		}
+	}
 
-		if (print_flags == MP[0]) {
-			BAIL_OUT_f(func, file, line, "It was mandatory for the last test to pass");
-		}
+	if (!tap_capture) {
+		UNLOCK;
 	}
-	free(local_test_name);
 
-	UNLOCK;
+	tap_line_free(&out);
+	tap_line_free(&name);
+
+	if (!ok && print_flags == MP[0]) {
+		BAIL_OUT_f(func, file, line, "It was mandatory for the last test to pass");
+	}
 
 	/* We only care (when testing) that ok is positive, but here we
 	   specifically only want to return 1 or 0 */
@@ -266,7 +734,7 @@ unsigned int _gen_result(int ok, const char *condition, const char *func,
 	va_list ap;
 
 	va_start(ap, test_name);
-	rtn = _vgen_result(ok, condition, NULL, NULL, func, file, line, test_name, ap);
+	rtn = _vgen_result(ok, condition, NULL, func, file, line, test_name, ap);
 	va_end(ap);
 
 	return rtn;
@@ -278,14 +746,42 @@ void tap_init_f(long flags, const char *func, const char *file, unsigned int lin
 	if (initialized) {
 		BAIL_OUT("Library is already initialized");
 	}
+	if (flags & TAP_FLAGS_COMPRESS_STRICT) {
+		flags |= TAP_FLAGS_COMPRESS;
+	}
+	if (flags & TAP_FLAGS_TIMING_PASS) {
+		flags |= TAP_FLAGS_TIMING;
+	}
+	if (flags & (TAP_FLAGS_TIMING | TAP_FLAGS_PERF | TAP_FLAGS_RUSAGE)) {
+		flags |= TAP_FLAGS_YAMLISH;
+	}
 	tap_flags = flags;
 	initialized = 1;
 
+	/* Forked processes share the output, so they write each line at once */
+	if ((flags & (TAP_FLAGS_BUFFERED | TAP_FLAGS_ASYNC)) && 
+	    !(flags & TAP_FLAGS_FORK)) {
+		tap_output_init(
+			(flags & TAP_FLAGS_BUFFERED ? TAP_OUTPUT_BUFFERED : 0) |
+			(flags & TAP_FLAGS_ASYNC ? TAP_OUTPUT_ASYNC : 0));
+#ifdef HAVE_LIBPTHREAD
+		pthread_atfork(tap_fork_prepare, tap_fork_done, tap_fork_child);
+#endif
+	}
 	atexit(_cleanup);
 	setbuf(stdout, 0);
 
 	tap_skip_init();
 	tap_todo_init();
+	tap_round_init();
+	if (flags & TAP_FLAGS_PERF) {
+		tap_perf_init();
+	}
+
+	if ((flags & TAP_FLAGS_FAST_PASS) && 
+	    !(flags & (TAP_FLAGS_TRACE | TAP_FLAGS_FORK | TAP_FLAGS_TIMING_PASS))) {
+		__atomic_sub_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+	}
 
 	if (flags & TAP_FLAGS_FORK) {
 		tap_shm = mmap(NULL, sizeof *tap_shm, 
@@ -297,18 +793,12 @@ void tap_init_f(long flags, const char *func, const char *file, unsigned int lin
 		}
 
 		tap_shm->main_pid = getpid();
-	}
-
 #ifdef HAVE_LIBPTHREAD
-	{
-		pthread_mutexattr_t attr;
-		pthread_mutexattr_init(&attr);
-		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-		pthread_mutex_init(&tap_shm->lock, &attr);
-		pthread_mutexattr_destroy(&attr);
-	}
+		pthread_atfork(tap_fork_share, NULL, NULL);
+#else
+		tap_fork_share();
 #endif
+	}
 }
 
 /*
@@ -339,17 +829,22 @@ int plan_no_plan(void)
  */
 int plan_skip_all(const char *reason)
 {
+	tap_line_t out;
+
 	INIT;
 	LOCK;
 
 	tap_shm->skip_all = 1;
 
-	printf("1..0");
+	tap_line_init(&out);
+	tap_line_puts(&out, "1..0");
 
 	if(reason != NULL)
-		printf(" # SKIP %s", reason);
+		tap_line_printf(&out, " # SKIP %s", reason);
 
-	printf("\n");
+	tap_line_putc(&out, '\n');
+	tap_output_line(STDOUT_FILENO, &out);
+	tap_line_free(&out);
 
 	UNLOCK;
 
@@ -390,27 +885,44 @@ int plan_tests(unsigned int tests)
 void diag(const char *fmt, ...)
 {
 	va_list ap;
+	tap_line_t out;
 
 	INIT;
-	LOCK;
 
-	fputs("# ", stderr);
+	tap_line_init(&out);
+	tap_line_puts(&out, "# ");
 
 	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
+	tap_line_vprintf(&out, fmt, ap);
 	va_end(ap);
 
-	fputs("\n", stderr);
+	tap_line_putc(&out, '\n');
 
-	UNLOCK;
+	if (tap_capture) {
+		tap_capture_put(tap_capture, TAP_REC_ERR, out.buf, out.len);
+	} else {
+		LOCK;
+		tap_output_line(STDERR_FILENO, &out);
+		UNLOCK;
+	}
+
+	tap_line_free(&out);
 }
 
 void _expected_tests(unsigned int tests)
 {
+	char buf[16];
+
 	INIT;
 	LOCK;
 
-	printf("1..%d\n", tests);
+	/* Number of lines isn't known in advance in the strict compressed 
+	   mode, the plan is printed at the end */
+	if (!(tap_flags & TAP_FLAGS_COMPRESS_STRICT)) {
+		tap_run_flush();
+		tap_output_write(STDOUT_FILENO, buf, 
+				snprintf(buf, sizeof buf, "1..%d\n", tests));
+	}
 	tap_shm->e_tests = tests;
 
 	UNLOCK;
@@ -419,37 +931,52 @@ void _expected_tests(unsigned int tests)
 int skip_f(unsigned int n, const char *fmt, ...)
 {
 	va_list ap;
-	char *skip_msg;
+	unsigned int count;
+	tap_line_t skip_msg;
+	tap_line_t out;
 
 	INIT;
-	LOCK;
+
+	tap_line_init(&skip_msg);
+	tap_line_init(&out);
 
 	va_start(ap, fmt);
-	if(vasprintf(&skip_msg, fmt, ap) < 0) {
-		skip_msg = NULL;
-	}
+	tap_line_vprintf(&skip_msg, fmt, ap);
 	va_end(ap);
 
-	while (n-- > 0) {
-		tap_shm->test_count++;
-		printf("ok %d # skip %s\n", tap_shm->test_count, 
-		       skip_msg != NULL ? 
-		       skip_msg : "libtap():malloc() failed");
+	if (tap_capture) {
+		tap_line_printf(&out, " # skip %s\n", skip_msg.buf);
+		while (n-- > 0) {
+			tap_capture_put(tap_capture, TAP_REC_OK, 
+					out.buf, out.len);
+		}
+	} else {
+		count = tap_lock(n);
+		tap_run_flush();
+		while (n-- > 0) {
+			tap_line_printf(&out, "ok %d # skip %s\n", 
+					tap_line_number(++count), 
+					skip_msg.buf);
+		}
+		tap_output_line(STDOUT_FILENO, &out);
+		UNLOCK;
 	}
 
-	free(skip_msg);
-
-	UNLOCK;
+	tap_line_free(&out);
+	tap_line_free(&skip_msg);
 
 	return 1;
 }
 
 int exit_status(void)
 {
+	unsigned int test_count;
 	int r;
 
 	LOCK;
 
+	test_count = tap_test_count();
+
 	if (tap_shm->main_pid && tap_shm->main_pid != getpid()) {
 		UNLOCK;
 		return 0;
@@ -463,31 +990,28 @@ int exit_status(void)
 
 	/* Ran too many tests?  Return the number of tests that were run
 	   that shouldn't have been */
-	if(tap_shm->e_tests < tap_shm->test_count) {
-		r = tap_shm->test_count - tap_shm->e_tests;
+	if(tap_shm->e_tests < test_count) {
+		r = test_count - tap_shm->e_tests;
 		UNLOCK;
 		return r;
 	}
 
 	/* Return the number of tests that failed + the number of tests 
 	   that weren't run */
-	r = tap_shm->failures + tap_shm->e_tests - tap_shm->test_count;
+	r = tap_shm->failures + tap_shm->e_tests - test_count;
 	UNLOCK;
 
 	return r;
 }
 
 /*
- * Cleanup at the end of the run, produce any final output that might be
- * required.
+ * Produce any final output that might be required. Called with the lock held.
  */
-void _cleanup(void)
+static void _summary(void)
 {
-
-	LOCK;
+	unsigned int test_count = tap_test_count();
 
 	if (tap_shm->main_pid && tap_shm->main_pid != getpid()) {
-		UNLOCK;
 		return;
 	}
 
@@ -496,13 +1020,11 @@ void _cleanup(void)
 	   before we could produce any output */
 	if(!tap_shm->no_plan && !tap_shm->have_plan && !tap_shm->skip_all) {
 		diag("Looks like your test died before it could output anything.");
-		UNLOCK;
 		return;
 	}
 
 	if(tap_shm->test_died) {
-		diag("Looks like your test died just after %d.", tap_shm->test_count);
-		UNLOCK;
+		diag("Looks like your test died just after %d.", test_count);
 		return;
 	}
 
@@ -510,27 +1032,52 @@ void _cleanup(void)
 	/* No plan provided, but now we know how many tests were run, and can
 	   print the header at the end */
 	if(!tap_shm->skip_all && (tap_shm->no_plan || !tap_shm->have_plan)) {
-		printf("1..%d\n", tap_shm->test_count);
+		char buf[16];
+		tap_output_write(STDOUT_FILENO, buf, snprintf(buf, sizeof buf,
+				"1..%d\n", tap_line_count(test_count)));
+	} else if (tap_flags & TAP_FLAGS_COMPRESS_STRICT) {
+		char buf[16];
+		unsigned int lines = tap_line_count(test_count);
+
+		/* Let the harness see the tests, which were not run */
+		if (tap_shm->e_tests > test_count) {
+			lines += tap_shm->e_tests - test_count;
+		}
+		tap_output_write(STDOUT_FILENO, buf, snprintf(buf, sizeof buf,
+				"1..%d\n", lines));
 	}
 
-	if((tap_shm->have_plan && !tap_shm->no_plan) && tap_shm->e_tests < tap_shm->test_count) {
+	if((tap_shm->have_plan && !tap_shm->no_plan) && tap_shm->e_tests < test_count) {
 		diag("Looks like you planned %d %s but ran %d extra.",
-		     tap_shm->e_tests, tap_shm->e_tests == 1 ? "test" : "tests", tap_shm->test_count - tap_shm->e_tests);
-		UNLOCK;
+		     tap_shm->e_tests, tap_shm->e_tests == 1 ? "test" : "tests", test_count - tap_shm->e_tests);
 		return;
 	}
 
-	if((tap_shm->have_plan || !tap_shm->no_plan) && tap_shm->e_tests > tap_shm->test_count) {
+	if((tap_shm->have_plan || !tap_shm->no_plan) && tap_shm->e_tests > test_count) {
 		diag("Looks like you planned %d %s but only ran %d.",
-		     tap_shm->e_tests, tap_shm->e_tests == 1 ? "test" : "tests", tap_shm->test_count);
-		UNLOCK;
+		     tap_shm->e_tests, tap_shm->e_tests == 1 ? "test" : "tests", test_count);
 		return;
 	}
 
 	if(tap_shm->failures)
 		diag("Looks like you failed %d %s of %d.", 
-		     tap_shm->failures, tap_shm->failures == 1 ? "test" : "tests", tap_shm->test_count);
+		     tap_shm->failures, tap_shm->failures == 1 ? "test" : "tests", test_count);
+}
+
+/*
+ * Cleanup at the end of the run
+ */
+void _cleanup(void)
+{
+	/* Forked rounds are reported by the parent */
+	if (tap_capture_streamed) {
+		return;
+	}
 
+	LOCK;
+	tap_run_flush();
+	_summary();
+	tap_output_flush();
 	UNLOCK;
 }
 
@@ -538,11 +1085,13 @@ int is_charp_f(const char *got, const char *expected, const char *condition,
 		const char *func, const char *file, int line, const char *fmt,
 		...)
 {
+	tap_values_t values = { tap_values_charp, { .str = got }, 
+			{ .str = expected }, "" };
 	va_list ap;
 	int rtn;
 
 	va_start(ap, fmt);
-	rtn = _vgen_result(0 == strcmp(got, expected), condition, got, expected,
+	rtn = _vgen_result(0 == strcmp(got, expected), condition, &values,
 			func, file, line, fmt, ap);
 	va_end(ap);
 
@@ -553,15 +1102,13 @@ int is_longlong_f(long long got, long long expected, const char *condition,
 		const char *func, const char *file, int line, const char *fmt, 
 		...)
 {
-	char got_buf[24], expected_buf[24];
+	tap_values_t values = { tap_values_longlong, { .s = got }, 
+			{ .s = expected }, "" };
 	va_list ap;
 	int rtn;
 
-	snprintf(got_buf, sizeof got_buf, "%lld", got);
-	snprintf(expected_buf, sizeof expected_buf, "%lld", expected);
-
 	va_start(ap, fmt);
-	rtn = _vgen_result(got == expected, condition, got_buf, expected_buf, 
+	rtn = _vgen_result(got == expected, condition, &values, 
 			func, file, line, fmt, ap);
 	va_end(ap);
 
@@ -572,15 +1119,13 @@ int is_ulonglong_f(unsigned long long got, unsigned long long expected,
 		const char *condition, const char *func, const char *file, 
 		int line, const char *fmt, ...)
 {
-	char got_buf[24], expected_buf[24];
+	tap_values_t values = { tap_values_ulonglong, { .u = got }, 
+			{ .u = expected }, "" };
 	va_list ap;
 	int rtn;
 
-	snprintf(got_buf, sizeof got_buf, "%llu", got);
-	snprintf(expected_buf, sizeof expected_buf, "%llu", expected);
-
 	va_start(ap, fmt);
-	rtn = _vgen_result(got == expected, condition, got_buf, expected_buf, 
+	rtn = _vgen_result(got == expected, condition, &values, 
 			func, file, line, fmt, ap);
 	va_end(ap);
 
@@ -591,11 +1136,12 @@ int isnt_charp_f(const char *got, const char *expected, const char *condition,
 		const char *func, const char *file, int line, const char *fmt,
 		...)
 {
+	tap_values_t values = { tap_values_charp, { .str = got } };
 	va_list ap;
 	int rtn;
 
 	va_start(ap, fmt);
-	rtn = _vgen_result(strcmp(got, expected), condition, got, NULL, 
+	rtn = _vgen_result(strcmp(got, expected), condition, &values, 
 			func, file, line, fmt, ap);
 	va_end(ap);
 
@@ -606,14 +1152,12 @@ int isnt_longlong_f(long long got, long long expected, const char *condition,
 		const char *func, const char *file, int line, const char *fmt,
 		...)
 {
-	char got_buf[24];
+	tap_values_t values = { tap_values_longlong, { .s = got } };
 	va_list ap;
 	int rtn;
 
-	snprintf(got_buf, sizeof got_buf, "%lld", got);
-
 	va_start(ap, fmt);
-	rtn = _vgen_result(got != expected, condition, got_buf, NULL, 
+	rtn = _vgen_result(got != expected, condition, &values, 
 			func, file, line, fmt, ap);
 	va_end(ap);
 
@@ -624,14 +1168,12 @@ int isnt_ulonglong_f(unsigned long long got, unsigned long long expected,
 		const char *condition, const char *func, const char *file, 
 		int line, const char *fmt, ...)
 {
-	char got_buf[24];
+	tap_values_t values = { tap_values_ulonglong, { .u = got } };
 	va_list ap;
 	int rtn;
 
-	snprintf(got_buf, sizeof got_buf, "%llu", got);
-
 	va_start(ap, fmt);
-	rtn = _vgen_result(got != expected, condition, got_buf, NULL, 
+	rtn = _vgen_result(got != expected, condition, &values, 
 			func, file, line, fmt, ap);
 	va_end(ap);
 
@@ -642,35 +1184,176 @@ int cmp_ok_f(int result, long long got, long long expected, const char *op,
 		const char *condition, const char *func, const char *file, 
 		int line, const char *fmt, ...)
 {
-	char got_buf[26], expected_buf[32];
+	tap_values_t values = { tap_values_cmp, { .s = got }, 
+			{ .s = expected }, op };
 	va_list ap;
 	int rtn;
 
-	snprintf(got_buf, sizeof got_buf, "0x%llx", got);
-	snprintf(expected_buf, sizeof got_buf, "%s 0x%llx", op, expected);
-	
 	va_start(ap, fmt);
-	rtn = _vgen_result(result, condition, got_buf, expected_buf, 
+	rtn = _vgen_result(result, condition, &values, 
 			func, file, line, fmt, ap);
 	va_end(ap);
 
 	return rtn;
 }
 
+/** Report a benchmark, its statistics are always in the YAMLish block
+ * @param name - test name, it's used as a format without arguments
+ */
+unsigned int tap_bench_result(const tap_bench_stats_t *stats, 
+		const char *func, const char *file, unsigned int line, 
+		const char *name, ...)
+{
+	tap_values_t values = { tap_values_bench, { .ptr = stats } };
+	va_list ap;
+	unsigned int rtn;
+
+	values.always = 1;
+
+	va_start(ap, name);
+	rtn = _vgen_result(1, NULL, &values, func, file, line, name, ap);
+	va_end(ap);
+
+	return rtn;
+}
+
+/** Report a comparison of benchmark statistics */
+unsigned int tap_bench_compare_result(int ok, double got, double expected, 
+		const char *op, const char *func, const char *file, 
+		unsigned int line, const char *fmt, ...)
+{
+	tap_values_t values = { tap_values_double, { .d = got }, 
+			{ .d = expected }, op };
+	va_list ap;
+	unsigned int rtn;
+
+	va_start(ap, fmt);
+	rtn = _vgen_result(ok, NULL, &values, func, file, line, fmt, ap);
+	va_end(ap);
+
+	return rtn;
+}
+
+/** Report a comparison of a count with its maximum */
+unsigned int tap_max_result(unsigned long long got, unsigned long long max,
+		const char *func, const char *file, unsigned int line, 
+		const char *fmt, ...)
+{
+	tap_values_t values = { tap_values_max, { .u = got }, 
+			{ .u = max }, "<=" };
+	va_list ap;
+	unsigned int rtn;
+
+	va_start(ap, fmt);
+	rtn = _vgen_result(got <= max, NULL, &values, func, file, line, fmt, 
+			ap);
+	va_end(ap);
+
+	return rtn;
+}
+
+/** Print failed tests and diagnostics of a captured repetition */
+static void tap_repeat_failed(const tap_capture_t *failed)
+{
+	const char *data, *end, *eol;
+	size_t pos = 0, len;
+	tap_rec_t kind;
+	int yamlish = 0;
+
+	diag("First failed repetition:");
+	while (NULL != (data = tap_capture_next(failed, &pos, &kind, &len))) {
+		/* The YAMLish block follows the failed test, the harness 
+		   newline may be between them */
+		if (kind == TAP_REC_OUT && yamlish) {
+			yamlish = 0;
+		} else if (kind != TAP_REC_NOT_OK && kind != TAP_REC_ERR) {
+			yamlish = 0;
+			continue;
+		} else if (kind == TAP_REC_NOT_OK) {
+			yamlish = 1;
+		}
+		for (end = data + len; data < end; data = eol + 1) {
+			eol = memchr(data, '\n', end - data);
+			if (eol == NULL) {
+				eol = end;
+			}
+			if (data == eol) {
+				continue;
+			} else if (kind == TAP_REC_NOT_OK && data[0] == ' ' && 
+			    data[1] == '-') {
+				diag("    not ok%.*s", (int)(eol - data), data);
+			} else if (kind == TAP_REC_ERR && data[0] == '#') {
+				diag("   %.*s", (int)(eol - data - 1), data + 1);
+			} else {
+				diag("    %.*s", (int)(eol - data), data);
+			}
+		}
+	}
+}
+
+/** Report a test, which doesn't have any source location */
+static unsigned int tap_values_result(int ok, const tap_values_t *values, 
+		const char *fmt, ...)
+{
+	va_list ap;
+	unsigned int rtn;
+
+	va_start(ap, fmt);
+	rtn = _vgen_result(ok, NULL, values, "tap_main", NULL, 0, fmt, ap);
+	va_end(ap);
+
+	return rtn;
+}
+
+/** Report the summary of repetitions of a round
+ * @param failed - capture of the first failed repetition or NULL
+ */
+unsigned int tap_repeat_result(const tap_repeat_stats_t *stats, 
+		const tap_capture_t *failed)
+{
+	tap_values_t values = { tap_values_repeat, { .ptr = stats } };
+
+	values.always = 1;
+
+	if (failed) {
+		tap_repeat_failed(failed);
+	}
+
+	return tap_values_result(stats->failures == 0, &values, 
+			"Round %lu passed %u of %u repetitions", stats->round, 
+			stats->repetitions - stats->failures, 
+			stats->repetitions);
+}
+
 void BAIL_OUT_f(const char *func, const char *file, int line, const char *fmt, 
 		...)
 {
 	va_list ap;
+	tap_line_t out;
 
 	// BAIL_OUT is not allowed to lock
 
-	printf("Bail out! ");
+	tap_line_init(&out);
+	tap_line_puts(&out, "Bail out! ");
 	if (fmt) {
 		va_start(ap, fmt);
-		vprintf(fmt, ap);
+		tap_line_vprintf(&out, fmt, ap);
 		va_end(ap);
 	}
-	printf(" at %s:%d\n", file, line);
+	tap_line_printf(&out, " at %s:%d\n", file, line);
+
+	if (tap_capture && tap_capture == tap_capture_streamed) {
+		tap_capture_put(tap_capture, TAP_REC_BAIL, out.buf, out.len);
+		tap_capture_flush(tap_capture);
+		_exit(255);
+	} else if (tap_capture) {
+		/* Rounds of -j are written in order by the pool */
+		tap_params_worker_bail(out.buf, out.len);
+	}
+
+	tap_run_flush();
+	tap_output_line(STDOUT_FILENO, &out);
+	tap_output_flush();
 
 	exit(255);
 }
@@ -138,12 +138,95 @@ enum tap_flags_e {
 	TAP_FLAGS_REPEAT_120 =  32,
 	TAP_FLAGS_TRACE      =  64,
 	TAP_FLAGS_YAMLISH    = 128,
+	TAP_FLAGS_BUFFERED   = 256,
+	TAP_FLAGS_FAST_PASS  = 512,
+	TAP_FLAGS_COMPRESS   = 1024,
+	TAP_FLAGS_COMPRESS_STRICT = 2048,
+	TAP_FLAGS_ASYNC      = 4096,
+	TAP_FLAGS_TIMING     = 8192,
+	TAP_FLAGS_TIMING_PASS = 16384,
+	TAP_FLAGS_PERF       = 32768,
+	TAP_FLAGS_RUSAGE     = 65536,
 } tap_flags_t;
 
+/** Hardware events counted by tap_perf(), see TAP_FLAGS_PERF */
+typedef enum tap_perf_event_e {
+	TAP_PERF_CYCLES,
+	TAP_PERF_INSTRUCTIONS,
+	TAP_PERF_BRANCH_MISSES,
+	TAP_PERF_L1D_MISSES,
+	TAP_PERF_LLC_MISSES,
+	TAP_PERF_DTLB_MISSES,
+	TAP_PERF_EVENTS
+} tap_perf_event_t;
+
 
 /** Initialize the TAP library
  * @param flags - Combination of tap_flags_t flags
  *
+ * With TAP_FLAGS_BUFFERED the output is collected in memory and written in
+ * big chunks. It is flushed on exit, BAIL_OUT() and fatal signals, but output
+ * printed directly by the test (eg. printf()) may appear out of order.
+ *
+ * With TAP_FLAGS_ASYNC the output is queued and written by a separate thread,
+ * so tests don't wait for a slow harness. The queue is drained on exit,
+ * BAIL_OUT() and fatal signals, the same caveats as for buffered output apply.
+ * Both flags have no effect together with TAP_FLAGS_FORK.
+ *
+ * With TAP_FLAGS_FORK processes forked by the test share test numbers and
+ * take turns writing results. A process killed while it writes a result
+ * leaves the others waiting for their turn forever.
+ *
+ * With TAP_FLAGS_FAST_PASS passing ok() and pass() only increment a counter
+ * and are reported without a name by the next test, which needs the full
+ * processing. Name arguments of passing tests are not evaluated then. The
+ * flag has no effect together with TAP_FLAGS_TRACE or TAP_FLAGS_FORK and
+ * inside of TODO blocks.
+ *
+ * With TAP_FLAGS_COMPRESS consecutive passed tests are reported by a single
+ * '# ok 1..49999 passed' comment, other results are printed in full. This
+ * output is not accepted by strict TAP consumers, use
+ * TAP_FLAGS_COMPRESS_STRICT for them instead. In that mode every run of passed
+ * tests is reported as one test and lines are renumbered accordingly, the plan
+ * is printed at the end.
+ *
+ * With TAP_FLAGS_TIMING the YAMLish block of a failed test contains
+ * duration_ns, the time since the previous test of the thread or since the
+ * start of the round, and since_start_ns, the time since the library was
+ * initialized. The flag implies TAP_FLAGS_YAMLISH. With TAP_FLAGS_TIMING_PASS
+ * passed tests get the block too, so it implies TAP_FLAGS_TIMING and it 
+ * disables TAP_FLAGS_FAST_PASS and TAP_FLAGS_COMPRESS of passed tests.
+ *
+ * With TAP_FLAGS_REPEAT_10, TAP_FLAGS_REPEAT_40 or TAP_FLAGS_REPEAT_120
+ * tap_main() executes every parameters set 10, 40 or 120 times (--repeat
+ * sets any number). Tests of repetitions aren't reported, every parameters
+ * set is reported by one test instead, which fails if any repetition failed.
+ * Its YAMLish block contains the flake rate and the distribution of
+ * durations of repetitions, both with 95% confidence intervals. Tests of the
+ * first failed repetition are printed as diagnostic messages.
+ *
+ * With TAP_FLAGS_PERF (--perf) the YAMLish block contains perf, counts of
+ * user space hardware events (see tap_perf_event_t) since the previous test
+ * of the thread or since the start of the round, TAP_BENCH reports them per
+ * iteration and tap_main() prints counts of every round as a diagnostic
+ * message. The flag implies TAP_FLAGS_YAMLISH, passed tests get the block
+ * with TAP_FLAGS_TIMING_PASS. If the kernel doesn't permit counting, it's
+ * reported once and the counts are left out.
+ *
+ * With TAP_FLAGS_RUSAGE (--rusage) the YAMLish block contains rusage, CPU
+ * times, page faults, context switches and bytes read and written by the
+ * thread since its previous test and the peak RSS of the process. Usage of
+ * every round is printed as a diagnostic message, with -v too. The flag
+ * implies TAP_FLAGS_YAMLISH.
+ *
+ * Tests linked with libtap-alloc (-Wl,--no-as-needed -ltap-alloc or
+ * LD_PRELOAD) count heap allocations of every round executed by tap_main().
+ * The library doesn't export anything the test calls, so linkers with
+ * --as-needed as the default drop it without --no-as-needed and nothing is
+ * tracked. Rounds, which don't free all memory allocated by their thread,
+ * are reported as diagnostic messages (all rounds with -v) and rounds with
+ * the largest peak of live bytes are printed at the end.
+ *
  * @ingroup public_api
  */
 #define tap_init(flags) \
@@ -171,8 +254,19 @@ enum tap_flags_e {
  *
  * @ingroup public_api
  */
+#ifdef __GNUC__
+#define ok(e, ...) \
+	__extension__ ({                                                      \
+		int __tap_ok = !!(e);                                         \
+		__builtin_expect(__tap_ok && !tap_fast_inhibit, 1) ?          \
+			tap_fast_pass() :                                     \
+			_gen_result(__tap_ok, #e, __func__, __FILE__,         \
+					__LINE__, __VA_ARGS__ + 0);           \
+	})
+#else
 #define ok(e, ...) \
 	_gen_result(!!(e), #e, __func__, __FILE__, __LINE__, __VA_ARGS__ + 0)
+#endif
 
 /** Note that a test passed
  * @...: the printf-style name of the test.
@@ -189,8 +283,15 @@ enum tap_flags_e {
  *
  * @ingroup public_api
  */
+#ifdef __GNUC__
+#define pass(...) \
+	(__builtin_expect(!tap_fast_inhibit, 1) ? tap_fast_pass() :           \
+		_gen_result(1, "Force PASS", __func__, __FILE__, __LINE__,    \
+				__VA_ARGS__ + 0))
+#else
 #define pass(...) \
 	_gen_result(1, "Force PASS", __func__, __FILE__, __LINE__, __VA_ARGS__ + 0)
+#endif
 
 /** Note that a test failed
  * @...: the printf-style name of the test.
@@ -432,24 +533,190 @@ enum tap_flags_e {
 		for (tap_todo_start(__VA_ARGS__ + 0); tap_todo_cond();)
 
 #ifdef __GNUC__
+/** Benchmark a block of code
+ * @param ... - Format string and arguments of the test name
+ *
+ * The block is run repeatedly. Runs of the calibration double the number of
+ * iterations until a sample takes at least 1 ms (--bench-time), they warm up
+ * caches and branch predictors too. Then 30 samples (--bench-samples) are
+ * timed by tap_bench_cycles() and one passed test is reported, its YAMLish
+ * block contains min, median, mean, p99 and stddev of ns per iteration.
+ *
+ * The name is formatted, when the benchmark starts, so TAP_PARAM() can be
+ * used in it and every parameters set gets its own test. Rounds should not
+ * run in parallel (-j) to be benchmarked reliably. The block must not be left
+ * by break, return or goto.
+ *
+ * @b Example:
+ * @code
+ * TAP_BENCH("memcpy of %d bytes", TAP_PARAM(size)) {
+ *     memcpy(dst, src, TAP_PARAM(size));
+ *     tap_bench_clobber();
+ * }
+ * @endcode
+ *
+ * @ingroup public_api
+ */
+#define TAP_BENCH(...) \
+	for (tap_bench_t *__tap_bench = tap_bench_start(__func__, __FILE__,   \
+			__LINE__, __VA_ARGS__ + 0);                          \
+	     __builtin_expect(__tap_bench->left-- != 0, 1) ||                 \
+	     tap_bench_next(__tap_bench);)
+
+/** Force the compiler to compute the value of x 
+ *
+ * The compiler must assume the value is used, so the computation of a result,
+ * which is otherwise thrown away, isn't removed from the benchmark body.
+ *
+ * @ingroup public_api
+ */
+#define tap_bench_do_not_optimize(x) \
+	__asm__ __volatile__("" : : "r,m"(x) : "memory")
+
+/** Force the compiler to assume all memory was read and written
+ *
+ * Stores of the benchmark body aren't removed and loads aren't hoisted out
+ * of the loop.
+ *
+ * @ingroup public_api
+ */
+#define tap_bench_clobber() \
+	__asm__ __volatile__("" : : : "memory")
+
+/** Test, the last TAP_BENCH of the thread isn't slower than its baseline
+ * @param name - name of the baseline, it's unique in a parameters set
+ * @param tolerance - allowed slowdown, 0.1 for 10 %
+ *
+ * The median of the benchmark is compared with the median stored in the
+ * baseline file (--baseline) for the same name and parameters set. The
+ * median may exceed the baseline by the tolerance and by three standard
+ * errors of the difference of medians, which are estimated from median
+ * absolute deviations of samples, so noisy machines don't fail randomly.
+ *
+ * The test is skipped, if the baseline doesn't exist. With --baseline-mode
+ * the baseline is recorded or updated instead, or a slowdown only prints
+ * a diagnostic message.
+ *
+ * @b Example:
+ * @code
+ * TAP_BENCH("sort of %d items", TAP_PARAM(size)) {
+ *     sort(array, TAP_PARAM(size));
+ * }
+ * ok_faster_than_baseline("sort", 0.05);
+ * @endcode
+ *
+ * @ingroup public_api
+ */
+#define ok_faster_than_baseline(name, tolerance) \
+	ok_faster_than_baseline_f(name, tolerance, __func__, __FILE__, __LINE__)
+
+/** Test, an iteration of the last TAP_BENCH of the thread didn't count more
+ *  hardware events than the maximum
+ * @param event - tap_perf_event_t
+ * @param max - maximal count per iteration
+ * @param ... - Optional test name format string and its arguments
+ *
+ * The test is skipped, if the event can't be counted.
+ *
+ * @b Example:
+ * @code
+ * TAP_BENCH("lookup") {
+ *     tap_bench_do_not_optimize(lookup(table, key));
+ * }
+ * ok_max_perf(TAP_PERF_LLC_MISSES, 2);
+ * @endcode
+ *
+ * @ingroup public_api
+ */
+#define ok_max_perf(event, max, ...) \
+	ok_max_perf_f(event, max, __func__, __FILE__, __LINE__, "" __VA_ARGS__)
+
+/** Test, the thread didn't have more page faults since the start of the round
+ * @param max - maximal number of minor and major faults
+ * @param ... - Optional test name format string and its arguments
+ *
+ * Without tap_main() rounds the faults since the start of the thread are
+ * counted.
+ *
+ * @ingroup public_api
+ */
+#define ok_max_faults(max, ...) \
+	ok_max_faults_f(max, __func__, __FILE__, __LINE__, "" __VA_ARGS__)
+
+/** Test, the thread wasn't switched out more times since the start of the
+ *  round
+ * @param max - maximal number of voluntary and involuntary context switches
+ * @param ... - Optional test name format string and its arguments
+ *
+ * Without tap_main() rounds the switches since the start of the thread are
+ * counted.
+ *
+ * @ingroup public_api
+ */
+#define ok_max_ctx_switches(max, ...) \
+	ok_max_ctx_switches_f(max, __func__, __FILE__, __LINE__, "" __VA_ARGS__)
+
 /** Define set of parameters.
- * @params ... - Parameters definition body, same syntax as in struct definition
+ * @params ... - Parameters declared by TAP_PARAM_FIELD
+ *
+ * The parameters become fields of tap_params_t and a descriptor of every
+ * parameter (name, offset, size and type) is emitted by the compiler, so
+ * -p, -d and -v don't need to parse anything at the start.
+ *
+ * The struct body of older versions (e.g. "unsigned long flags; char
+ * *data;") is still accepted. Its text is parsed at the start instead, only
+ * parameters of basic types (numbers, char and char *) can be set by -p and
+ * -d then and only if the layout of the structure is understood. Convert
+ * every "type name;" to "TAP_PARAM_FIELD(name, type)" to get all of them.
  *
  * @b Example:
  * @code
  * TAP_PARAMS_DEFINITION(
- *     unsigned long flags;
- *     enum {
+ *     TAP_PARAM_FIELD(flags, unsigned long)
+ *     TAP_PARAM_FIELD(command, enum {
  *         FIRST_COMMAND,
  *         SECOND_COMMAND,
- *     } command;
- *     char *data;
+ *     })
+ *     TAP_PARAM_FIELD(data, char *)
  * )
  * @endcode
  *
  * @ingroup public_api
  */
 #define TAP_PARAMS_DEFINITION(...) \
+	__TAP_PARAMS_SELECT(__TAP_PARAMS_PROBE __VA_ARGS__)(__VA_ARGS__)
+
+/* TAP_PARAM_FIELD expands to a parenthesized pair, which consumes the probe
+   macro, the struct body of the legacy form doesn't start with a parenthesis
+   and leaves the probe untouched. The token pasted to the probe selects the
+   definition. */
+
+#define __TAP_PARAMS_PROBE(...) __TAP_PARAMS_PROBED
+#define __TAP_PARAMS_SELECT(...) __TAP_PARAMS_SELECT_(__VA_ARGS__)
+#define __TAP_PARAMS_SELECT_(...) \
+	__TAP_PARAMS_FIRST(__TAP_PARAMS_IS_ ## __VA_ARGS__)
+#define __TAP_PARAMS_IS___TAP_PARAMS_PROBED __TAP_PARAMS_FIELDS,
+#define __TAP_PARAMS_IS___TAP_PARAMS_PROBE __TAP_PARAMS_LEGACY,
+#define __TAP_PARAMS_FIRST(...) __TAP_PARAMS_FIRST_(__VA_ARGS__)
+#define __TAP_PARAMS_FIRST_(first, ...) first
+
+/** Parameters declared by TAP_PARAM_FIELD */
+#define __TAP_PARAMS_FIELDS(...) \
+	typedef struct tap_params_s {                                        \
+		tap_params_header_t tap;                                     \
+		TAP_SEQ(__TAP_PARAMS_FIELD_A __VA_ARGS__)                    \
+	} tap_params_t;                                                      \
+	unsigned long tap_params_size = sizeof(tap_params_t);                \
+	static tap_param_desc_t __tap_params_desc[] = {                      \
+		TAP_SEQ(__TAP_PARAMS_DESC_A __VA_ARGS__)                     \
+	};                                                                   \
+	tap_param_desc_t *const tap_params_desc[2] = {                       \
+		__tap_params_desc, __tap_params_desc +                       \
+			sizeof __tap_params_desc / sizeof(tap_param_desc_t)  \
+	};
+
+/** Parameters declared by the struct body, they are parsed at the start */
+#define __TAP_PARAMS_LEGACY(...) \
 	typedef struct tap_params_s {                          \
 		tap_params_header_t tap;                       \
 		__VA_ARGS__                                    \
@@ -457,6 +724,42 @@ enum tap_flags_e {
 	const char tap_params_def[] = #__VA_ARGS__;            \
 	unsigned long tap_params_size = sizeof(tap_params_t);
 
+/** Declare a parameter in TAP_PARAMS_DEFINITION
+ * @param name - name of the parameter
+ * @param ... - type of the parameter, eg. char[16] for an array
+ *
+ * @ingroup public_api
+ */
+#define TAP_PARAM_FIELD(name, ...) (name, __VA_ARGS__)
+
+/* Fields and descriptors are generated from the sequence of parameters by
+   macros, which expand one element and leave the other one to expand the
+   following element. The name of the last one is completed by TAP_SEQ. */
+
+#define __TAP_PARAMS_FIELD(name, ...) __typeof__(__VA_ARGS__) name;
+#define __TAP_PARAMS_FIELD_A(...) \
+	__TAP_PARAMS_FIELD(__VA_ARGS__) __TAP_PARAMS_FIELD_B
+#define __TAP_PARAMS_FIELD_B(...) \
+	__TAP_PARAMS_FIELD(__VA_ARGS__) __TAP_PARAMS_FIELD_A
+#define __TAP_PARAMS_FIELD_A_END
+#define __TAP_PARAMS_FIELD_B_END
+
+#define __TAP_PARAMS_DESC(name, ...) { \
+		#name, #__VA_ARGS__, __builtin_offsetof(tap_params_t, name), \
+		sizeof(((tap_params_t*)0)->name),                            \
+		TAP_PARAM_TYPE(((tap_params_t*)0)->name)                     \
+	},
+#define __TAP_PARAMS_DESC_A(...) \
+	__TAP_PARAMS_DESC(__VA_ARGS__) __TAP_PARAMS_DESC_B
+#define __TAP_PARAMS_DESC_B(...) \
+	__TAP_PARAMS_DESC(__VA_ARGS__) __TAP_PARAMS_DESC_A
+#define __TAP_PARAMS_DESC_A_END
+#define __TAP_PARAMS_DESC_B_END
+
+/** Expand a sequence of TAP_PARAM_FIELD by the macro before it */
+#define TAP_SEQ(...) __TAP_SEQ(__VA_ARGS__)
+#define __TAP_SEQ(...) __VA_ARGS__ ## _END
+
 /** Define one or more values of TAP_PARAMS_DEFINITION.
  *
  * @b Example:
@@ -481,7 +784,7 @@ enum tap_flags_e {
 #define TAP_PARAMS_VALUES_ARRAY(...) \
 	tap_params_t tap_params_values[] = {__VA_ARGS__};  \
 	const char tap_params_values_def[] = #__VA_ARGS__; \
-	extern tap_params_t *tap_params_current;           \
+	extern __thread tap_params_t *tap_params_current;  \
 	unsigned long tap_params_values_nmemb =            \
 		sizeof(tap_params_values)/sizeof(tap_params_values[0]);
 
@@ -493,6 +796,60 @@ enum tap_flags_e {
 #define TAP_PARAMS_VALUES(...) \
 	{__VA_ARGS__}
 
+/** Define rounds as the Cartesian product of values of axes.
+ * @params ... - Values shared by all rounds, same syntax as TAP_PARAMS_VALUES
+ *
+ * Axes are declared by TAP_PARAMS_AXIS in the same file. Rounds aren't
+ * stored, round i is built when it's executed from i written in the mixed
+ * radix of the axes sizes, the axis declared last changes the fastest.
+ *
+ * @b Example:
+ * @code
+ * TAP_PARAMS_AXIS(size, 1, 16, 256, 4096);
+ * TAP_PARAMS_AXIS(threads, 1, 2, 4);
+ * TAP_PARAMS_AXIS(data, "zero", "random");
+ * TAP_PARAMS_MATRIX(
+ *     .tap.plan = 2,
+ *     .flags = 42,
+ * )
+ * @endcode
+ *
+ * @ingroup public_api
+ */
+#define TAP_PARAMS_MATRIX(...) \
+	tap_params_t tap_params_values[] = {{__VA_ARGS__}};        \
+	const char tap_params_values_def[] =                       \
+		"TAP_PARAMS_VALUES(" #__VA_ARGS__ ")";             \
+	extern __thread tap_params_t *tap_params_current;          \
+	unsigned long tap_params_values_nmemb = 1;                 \
+	extern tap_params_axis_t __start___tap_axes[]              \
+		__attribute__((weak));                             \
+	extern tap_params_axis_t __stop___tap_axes[]               \
+		__attribute__((weak));                             \
+	tap_params_axis_t *const tap_params_axes[2] = {            \
+		__start___tap_axes, __stop___tap_axes              \
+	};
+
+/** Define values of one parameter of TAP_PARAMS_MATRIX.
+ * @param name - name of the parameter
+ * @params ... - values of the parameter
+ *
+ * @ingroup public_api
+ */
+#define TAP_PARAMS_AXIS(name, ...) \
+	static typeof(((tap_params_t*)0)->name)                              \
+			TAP_IDENT(axis_vals_, __LINE__)[] = {__VA_ARGS__};   \
+	static tap_params_axis_t TAP_IDENT(axis_, __LINE__)                  \
+			__attribute__((section("__tap_axes"), used,          \
+			aligned(__alignof__(tap_params_axis_t)))) = {        \
+		#name, #__VA_ARGS__, __LINE__,                               \
+		__builtin_offsetof(tap_params_t, name),                      \
+		sizeof(((tap_params_t*)0)->name),                            \
+		sizeof(TAP_IDENT(axis_vals_, __LINE__)) /                    \
+			sizeof(((tap_params_t*)0)->name),                    \
+		TAP_IDENT(axis_vals_, __LINE__)                              \
+	}
+
 /** Get current value of parameter 
  * @param name - name of the parameter
  *
@@ -504,10 +861,26 @@ enum tap_flags_e {
  * @ingroup public_api
  */
 #define TAP_PARAM(name) \
-	(tap_params_override_active ?                                        \
-		*(typeof(tap_params_values[0].name)*)tap_get_override(       \
-			#name, &tap_params_current->name) :                  \
-		tap_params_current->name)
+	(tap_params_current->name)
+
+/** TAP_PARAM_TYPE helper */
+#define __TAP_PARAM_IS(x, type) \
+	__builtin_types_compatible_p(typeof(x), type)
+
+/** Type of a parameter, only these types can be overridden */
+#define TAP_PARAM_TYPE(x) \
+	(__TAP_PARAM_IS(x, char *) || __TAP_PARAM_IS(x, const char *) ?      \
+		TAP_PARAM_STRING :                                           \
+	 __TAP_PARAM_IS(x, char) ? TAP_PARAM_CHAR :                          \
+	 __TAP_PARAM_IS(x, signed char) || __TAP_PARAM_IS(x, short) ||       \
+	 __TAP_PARAM_IS(x, int) || __TAP_PARAM_IS(x, long) ||                \
+	 __TAP_PARAM_IS(x, long long) ? TAP_PARAM_SIGNED :                   \
+	 __TAP_PARAM_IS(x, unsigned char) ||                                 \
+	 __TAP_PARAM_IS(x, unsigned short) ||                                \
+	 __TAP_PARAM_IS(x, unsigned int) ||                                  \
+	 __TAP_PARAM_IS(x, unsigned long) ||                                 \
+	 __TAP_PARAM_IS(x, unsigned long long) ? TAP_PARAM_UNSIGNED :        \
+	 TAP_PARAM_OTHER)
 
 /** Set library flags
  *
@@ -604,11 +977,97 @@ int cmp_ok_f(int result, long long get, long long expected, const char *op,
 
 void BAIL_OUT_f(const char *func, const char *file, int line, const char *fmt, ...);
 
+int skip_f(unsigned int n, const char *fmt, ...);
+
 unsigned int _gen_result(int, const char *, const char *, const char *,
 		unsigned int, const char *, ...);
 
 void tap_init_f(long flags, const char *func, const char *file, unsigned int line);
 
+/** Fast path of ok() and pass() is used only while this is zero */
+extern int tap_fast_inhibit;
+
+/** Passed tests, which weren't reported yet */
+extern unsigned int tap_fast_passes;
+
+#ifdef __GNUC__
+/** Record a passed test without reporting it */
+static inline unsigned int tap_fast_pass(void)
+{
+	__atomic_add_fetch(&tap_fast_passes, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+#endif
+
+/* From tap_bench.c */
+
+/** Benchmark state, which is touched by every iteration of TAP_BENCH */
+typedef struct tap_bench_s {
+	/** Iterations left in the current sample */
+	unsigned long left;
+} tap_bench_t;
+
+tap_bench_t *tap_bench_start(const char *func, const char *file, 
+		unsigned int line, const char *fmt, ...);
+
+int tap_bench_next(tap_bench_t *bench);
+
+double tap_bench_ns(unsigned long long cycles);
+
+double tap_bench_perf(tap_perf_event_t event);
+
+/* From tap_perf.c */
+
+unsigned long long tap_perf(tap_perf_event_t event);
+
+int tap_perf_available(tap_perf_event_t event);
+
+int ok_max_perf_f(tap_perf_event_t event, double max, const char *func, 
+		const char *file, unsigned int line, const char *fmt, ...);
+
+/* From tap_rusage.c */
+
+int ok_max_faults_f(unsigned long max, const char *func, const char *file, 
+		unsigned int line, const char *fmt, ...);
+
+int ok_max_ctx_switches_f(unsigned long max, const char *func, 
+		const char *file, unsigned int line, const char *fmt, ...);
+
+/* From tap_baseline.c */
+
+int ok_faster_than_baseline_f(const char *name, double tolerance, 
+		const char *func, const char *file, unsigned int line);
+
+unsigned long long tap_bench_clock(void);
+
+#ifdef __GNUC__
+/** Read the cycle timer
+ *
+ * It's the time stamp counter on x86 and the virtual counter on ARM64, other
+ * architectures use the monotonic clock. Differences of values are converted
+ * to ns by tap_bench_ns().
+ *
+ * @ingroup public_api
+ */
+static inline unsigned long long tap_bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int lo, hi;
+
+	__asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi) : : "memory");
+	return (unsigned long long)hi << 32 | lo;
+#elif defined(__aarch64__)
+	unsigned long long cycles;
+
+	__asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(cycles) : : 
+			"memory");
+	return cycles;
+#else
+	return tap_bench_clock();
+#endif
+}
+#endif
+
 /* From tap_skip_todo.c */
 
 void tap_skip_start(void);
@@ -623,14 +1082,51 @@ int tap_todo_cond(void);
 
 /** PARAMS_VALUES header */
 typedef struct tap_params_header_s {
-	/** True, if this parameter combination should be skipped */
+	/** True, if this parameter combination should be skipped, it's read
+	 * once at the start, -r and --shard don't modify it */
 	int skip;
 	/** How many test cases should be executed for this values */
 	int plan;
 } tap_params_header_t;
 
-extern int tap_params_override_active;
-
-void *tap_get_override(const char *name, void *value);
+/** Types of parameters, see TAP_PARAM_TYPE */
+enum tap_param_type_e {
+	TAP_PARAM_OTHER,
+	TAP_PARAM_SIGNED,
+	TAP_PARAM_UNSIGNED,
+	TAP_PARAM_CHAR,
+	TAP_PARAM_STRING,
+};
+
+/** Descriptor of a parameter, see TAP_PARAMS_DEFINITION */
+typedef struct tap_param_desc_s {
+	const char *name;
+	/** Type as it was written */
+	const char *decl;
+	unsigned long offset;
+	unsigned long size;
+	enum tap_param_type_e type;
+	/** Value set by the -p option or NULL */
+	void *override;
+} tap_param_desc_t;
+
+/** Bounds of the descriptors array, see TAP_PARAMS_DEFINITION */
+extern tap_param_desc_t *const tap_params_desc[2];
+
+/** Axis of TAP_PARAMS_MATRIX */
+typedef struct tap_params_axis_s {
+	const char *name;
+	/** Values as they were written */
+	const char *def;
+	/** Axes are ordered by the line of their declaration */
+	int line;
+	unsigned long offset;
+	unsigned long size;
+	unsigned long nmemb;
+	const void *vals;
+} tap_params_axis_t;
+
+/** Bounds of the axes section, see TAP_PARAMS_MATRIX */
+extern tap_params_axis_t *const tap_params_axes[2];
 
 #endif /* TAP_H */
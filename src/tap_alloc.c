@@ -0,0 +1,161 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Allocation tracker, the library is linked to a test (-Wl,--no-as-needed
+   -ltap-alloc, --as-needed would drop it) or preloaded to interpose the
+   malloc family of glibc. libtap reports the counts, if it finds the
+   library. */
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+#include "tap_alloc.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+/* The initial exec model doesn't allocate on the first access */
+static __thread tap_alloc_counts_t tap_alloc_counts 
+		__attribute__ ((tls_model("initial-exec")));
+
+tap_alloc_counts_t *tap_alloc_thread(void)
+{
+	return &tap_alloc_counts;
+}
+
+static inline void *tap_alloc_add(void *ptr)
+{
+	tap_alloc_counts_t *counts = &tap_alloc_counts;
+	size_t size;
+
+	if (ptr == NULL || counts->ignore) {
+		return ptr;
+	}
+
+	size = malloc_usable_size(ptr);
+	counts->allocs++;
+	counts->bytes += size;
+	counts->live += size;
+	if (counts->live > counts->peak) {
+		counts->peak = counts->live;
+	}
+
+	return ptr;
+}
+
+static inline void tap_alloc_sub(void *ptr)
+{
+	if (ptr != NULL && !tap_alloc_counts.ignore) {
+		tap_alloc_counts.live -= malloc_usable_size(ptr);
+	}
+}
+
+void *malloc(size_t size)
+{
+	return tap_alloc_add(__libc_malloc(size));
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	return tap_alloc_add(__libc_calloc(nmemb, size));
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	size_t old = ptr && !tap_alloc_counts.ignore ? 
+			malloc_usable_size(ptr) : 0;
+	void *rtn = __libc_realloc(ptr, size);
+
+	/* The old block is kept, if the reallocation fails */
+	if (rtn != NULL || size == 0) {
+		tap_alloc_counts.live -= old;
+		tap_alloc_add(rtn);
+	}
+
+	return rtn;
+}
+
+void *reallocarray(void *ptr, size_t nmemb, size_t size)
+{
+	size_t total;
+
+	if (__builtin_mul_overflow(nmemb, size, &total)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	return realloc(ptr, total);
+}
+
+void free(void *ptr)
+{
+	tap_alloc_sub(ptr);
+	__libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+	return tap_alloc_add(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	return tap_alloc_add(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+	void *rtn;
+
+	if (alignment == 0 || alignment % sizeof(void *) || 
+	    alignment & (alignment - 1)) {
+		return EINVAL;
+	}
+
+	rtn = tap_alloc_add(__libc_memalign(alignment, size));
+	if (rtn == NULL) {
+		return ENOMEM;
+	}
+	*ptr = rtn;
+
+	return 0;
+}
+
+void *valloc(size_t size)
+{
+	return tap_alloc_add(__libc_valloc(size));
+}
+
+void *pvalloc(size_t size)
+{
+	return tap_alloc_add(__libc_pvalloc(size));
+}
@@ -0,0 +1,51 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_ALLOC_H
+#define TAP_ALLOC_H
+
+/** Heap usage of a thread counted by libtap-alloc
+ *
+ * Sizes are usable sizes of blocks, blocks freed by another thread than
+ * the one, which allocated them, are subtracted from the usage of the
+ * thread, which freed them.
+ */
+typedef struct tap_alloc_counts_s {
+	/** Allocations including reallocations */
+	unsigned long long allocs;
+	/** Bytes allocated */
+	unsigned long long bytes;
+	/** Bytes allocated and not freed */
+	long long live;
+	/** Maximum of live bytes */
+	long long peak;
+	/** Allocations and frees are not counted while it's not zero */
+	int ignore;
+} tap_alloc_counts_t;
+
+tap_alloc_counts_t *tap_alloc_thread(void);
+
+#endif // TAP_ALLOC_H
@@ -0,0 +1,130 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "tap_arena.h"
+
+/** Size of the per-thread scratch arena */
+#define TAP_ARENA_SIZE 4096
+
+/** Marks allocations, which didn't fit into the arena */
+#define TAP_ARENA_HEAP ((size_t)-1)
+
+/** Allocation header */
+typedef union tap_arena_hdr_u {
+	/** Top of the arena before the allocation or TAP_ARENA_HEAP */
+	size_t prev;
+	/** Keeps allocations aligned */
+	long double align;
+} tap_arena_hdr_t;
+
+#define TAP_ARENA_ALIGN(size) \
+	(((size) + sizeof(tap_arena_hdr_t) - 1) & ~(sizeof(tap_arena_hdr_t) - 1))
+
+/* Memory for short lived strings and SKIP/TODO blocks. Blocks are nested, so
+   the memory is released in the reverse order and a stack is sufficient */
+
+static __thread tap_arena_hdr_t tap_arena[TAP_ARENA_SIZE / sizeof(tap_arena_hdr_t)];
+
+static __thread size_t tap_arena_top;
+
+/** Allocate memory from the arena, falls back to malloc() if it's full */
+void *tap_arena_alloc(size_t size)
+{
+	size_t need = sizeof(tap_arena_hdr_t) + TAP_ARENA_ALIGN(size);
+	tap_arena_hdr_t *hdr;
+
+	if (tap_arena_top + need <= sizeof tap_arena) {
+		hdr = (tap_arena_hdr_t*)((char*)tap_arena + tap_arena_top);
+		hdr->prev = tap_arena_top;
+		tap_arena_top += need;
+	} else {
+		hdr = malloc(sizeof(tap_arena_hdr_t) + size);
+		if (hdr == NULL) {
+			return NULL;
+		}
+		hdr->prev = TAP_ARENA_HEAP;
+	}
+
+	return hdr + 1;
+}
+
+/** Release memory allocated by tap_arena_alloc()
+ *
+ * Memory must be released in the reverse order of the allocation.
+ */
+void tap_arena_free(void *ptr)
+{
+	tap_arena_hdr_t *hdr = (tap_arena_hdr_t*)ptr - 1;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	if (hdr->prev == TAP_ARENA_HEAP) {
+		free(hdr);
+	} else {
+		tap_arena_top = hdr->prev;
+	}
+}
+
+/** Format a string into the arena, release it with tap_arena_free() */
+char *tap_arena_vprintf(const char *fmt, va_list ap)
+{
+	size_t avail = sizeof tap_arena - tap_arena_top;
+	char *str;
+	va_list aq;
+	int len;
+
+	if (avail > sizeof(tap_arena_hdr_t)) {
+		avail -= sizeof(tap_arena_hdr_t);
+	} else {
+		avail = 0;
+	}
+
+	/* Try to format directly into the free space first */
+	str = (char*)tap_arena + tap_arena_top + sizeof(tap_arena_hdr_t);
+	va_copy(aq, ap);
+	len = vsnprintf(avail ? str : NULL, avail, fmt, aq);
+	va_end(aq);
+
+	if (len < 0) {
+		return NULL;
+	}
+
+	if (len < avail) {
+		return tap_arena_alloc(len + 1);
+	}
+
+	str = tap_arena_alloc(len + 1);
+	if (str) {
+		vsnprintf(str, len + 1, fmt, ap);
+	}
+
+	return str;
+}
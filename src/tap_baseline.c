@@ -0,0 +1,358 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_baseline.h"
+#include "tap_bench.h"
+#include "tap_output.h"
+#include "tap_round.h"
+#include "tap.h"
+
+/** Standard errors of the difference of medians allowed as noise */
+#define TAP_BASELINE_SIGMAS 3
+
+/** Standard deviation of normally distributed samples per their MAD */
+#define TAP_BASELINE_MAD_SIGMA 1.4826
+
+/** Standard error of a median per standard error of a mean */
+#define TAP_BASELINE_MEDIAN_SE 1.2533
+
+enum tap_baseline_mode_e tap_baseline_mode = TAP_BASELINE_CHECK;
+
+/** Baseline file, <program>.baseline if NULL */
+const char *tap_baseline_file;
+
+/** Baseline of one test in one round */
+struct tap_baseline_entry_s {
+	long round;
+	char *name;
+	double median;
+	double mad;
+	unsigned int samples;
+	/** Line in the file, the last line of a test wins */
+	unsigned long order;
+};
+
+/** Baselines sorted by the round and the name */
+static struct tap_baseline_s {
+	struct tap_baseline_entry_s *entries;
+	unsigned long nmemb;
+} tap_baseline;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_once_t tap_baseline_once = PTHREAD_ONCE_INIT;
+#else
+static int tap_baseline_once;
+#endif
+
+static int tap_baseline_key_cmp(const void *a, const void *b)
+{
+	const struct tap_baseline_entry_s *x = a, *y = b;
+
+	if (x->round != y->round) {
+		return x->round < y->round ? -1 : 1;
+	}
+
+	return strcmp(x->name, y->name);
+}
+
+static int tap_baseline_cmp(const void *a, const void *b)
+{
+	const struct tap_baseline_entry_s *x = a, *y = b;
+	int rtn = tap_baseline_key_cmp(a, b);
+
+	if (rtn) {
+		return rtn;
+	}
+
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/** Read the baseline file, only the last line of every test is kept */
+static void tap_baseline_read(struct tap_baseline_s *baseline)
+{
+	struct tap_baseline_entry_s entry, *tmp;
+	unsigned long i, size = 0;
+	char line[4096];
+	size_t len;
+	int name;
+	FILE *f;
+
+	baseline->entries = NULL;
+	baseline->nmemb = 0;
+
+	f = fopen(tap_baseline_file, "r");
+	if (f == NULL) {
+		return;
+	}
+
+	for (entry.order = 0; fgets(line, sizeof line, f); entry.order++) {
+		if (line[0] == '#' || 4 != sscanf(line, "%ld %lf %lf %u %n", 
+				&entry.round, &entry.median, &entry.mad, 
+				&entry.samples, &name) || entry.samples == 0) {
+			continue;
+		}
+
+		len = strlen(line + name);
+		if (len && line[name + len - 1] == '\n') {
+			line[name + --len] = '\0';
+		}
+		entry.name = strdup(line + name);
+		if (entry.name == NULL) {
+			break;
+		}
+
+		if (baseline->nmemb == size) {
+			size = size ? 2 * size : 64;
+			tmp = realloc(baseline->entries, size * sizeof *tmp);
+			if (tmp == NULL) {
+				free(entry.name);
+				break;
+			}
+			baseline->entries = tmp;
+		}
+		baseline->entries[baseline->nmemb++] = entry;
+	}
+
+	fclose(f);
+
+	qsort(baseline->entries, baseline->nmemb, 
+			sizeof baseline->entries[0], tap_baseline_cmp);
+
+	/* Drop older lines of tests, which were stored several times */
+	for (size = i = 0; i < baseline->nmemb; i++) {
+		if (i + 1 < baseline->nmemb && 
+		    !tap_baseline_key_cmp(&baseline->entries[i], 
+				&baseline->entries[i + 1])) {
+			free(baseline->entries[i].name);
+			continue;
+		}
+		baseline->entries[size++] = baseline->entries[i];
+	}
+	baseline->nmemb = size;
+}
+
+static void tap_baseline_free(struct tap_baseline_s *baseline)
+{
+	unsigned long i;
+
+	for (i = 0; i < baseline->nmemb; i++) {
+		free(baseline->entries[i].name);
+	}
+	free(baseline->entries);
+}
+
+/** Set the default file name, tap_main() sets it from argv[0] */
+static void tap_baseline_default(void)
+{
+	static char file[4096];
+	ssize_t len;
+
+	if (tap_baseline_file) {
+		return;
+	}
+
+	len = readlink("/proc/self/exe", file, sizeof file - sizeof ".baseline");
+	if (len < 0) {
+		len = 0;
+	}
+	strcpy(file + len, len ? ".baseline" : "tap.baseline");
+	tap_baseline_file = file;
+}
+
+static void tap_baseline_load(void)
+{
+	tap_baseline_default();
+	tap_baseline_read(&tap_baseline);
+}
+
+/** Prepare the baseline file before rounds start
+ *
+ * It must be called before the rounds are executed, the baseline is 
+ * truncated in the record mode. Results of rounds are appended to the file,
+ * as they may be executed in other processes.
+ */
+void tap_baseline_init(void)
+{
+	FILE *f;
+
+	tap_baseline_default();
+
+	if (tap_baseline_mode == TAP_BASELINE_RECORD) {
+		f = fopen(tap_baseline_file, "w");
+		if (f == NULL) {
+			BAIL_OUT("Can't create %s: %s", tap_baseline_file, 
+					strerror(errno));
+		}
+		fprintf(f, "# round median_ns mad_ns samples name\n");
+		fclose(f);
+	}
+}
+
+/** Rewrite the baseline file without older results of tests */
+void tap_baseline_finish(void)
+{
+	struct tap_baseline_s baseline;
+	struct tap_baseline_entry_s *entry;
+	unsigned long i;
+	char *tmp;
+	FILE *f;
+
+	if (tap_baseline_mode != TAP_BASELINE_RECORD && 
+	    tap_baseline_mode != TAP_BASELINE_UPDATE) {
+		return;
+	}
+
+	tap_baseline_read(&baseline);
+
+	tmp = malloc(strlen(tap_baseline_file) + sizeof ".tmp");
+	if (tmp == NULL) {
+		tap_baseline_free(&baseline);
+		return;
+	}
+	sprintf(tmp, "%s.tmp", tap_baseline_file);
+
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		tap_baseline_free(&baseline);
+		free(tmp);
+		return;
+	}
+
+	fprintf(f, "# round median_ns mad_ns samples name\n");
+	for (i = 0; i < baseline.nmemb; i++) {
+		entry = &baseline.entries[i];
+		fprintf(f, "%ld %.3f %.3f %u %s\n", entry->round, 
+				entry->median, entry->mad, entry->samples, 
+				entry->name);
+	}
+
+	if (fclose(f) == 0) {
+		rename(tmp, tap_baseline_file);
+	} else {
+		unlink(tmp);
+	}
+
+	tap_baseline_free(&baseline);
+	free(tmp);
+}
+
+/** Append the result of the test, one write keeps lines of rounds whole */
+static void tap_baseline_store(const char *name, 
+		const tap_bench_stats_t *stats)
+{
+	tap_line_t line;
+	const char *c;
+	int fd;
+
+	tap_line_init(&line);
+	tap_line_printf(&line, "%ld %.3f %.3f %u ", tap_round_current, 
+			stats->median, stats->mad, stats->samples);
+	for (c = name; *c; c++) {
+		tap_line_putc(&line, *c == '\n' ? ' ' : *c);
+	}
+	tap_line_putc(&line, '\n');
+
+	fd = open(tap_baseline_file, O_WRONLY | O_APPEND | O_CREAT, 0666);
+	if (fd < 0 || write(fd, line.buf, line.len) != (ssize_t)line.len) {
+		diag("    Can't store the baseline of %s to %s: %s", name, 
+				tap_baseline_file, strerror(errno));
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	tap_line_free(&line);
+}
+
+int ok_faster_than_baseline_f(const char *name, double tolerance, 
+		const char *func, const char *file, unsigned int line)
+{
+	const tap_bench_stats_t *stats = tap_bench_last;
+	struct tap_baseline_entry_s key, *base;
+	double noise, limit;
+	int ok;
+
+	if (stats == NULL) {
+		diag("    No benchmark was run before the test of %s", name);
+		return _gen_result(0, NULL, func, file, line, 
+				"%s is not slower than its baseline", name);
+	}
+
+	if (tap_baseline_mode == TAP_BASELINE_RECORD || 
+	    tap_baseline_mode == TAP_BASELINE_UPDATE) {
+		tap_baseline_default();
+		tap_baseline_store(name, stats);
+		return skip_f(1, "Baseline of %s stored", name);
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_once(&tap_baseline_once, tap_baseline_load);
+#else
+	if (!tap_baseline_once) {
+		tap_baseline_once = 1;
+		tap_baseline_load();
+	}
+#endif
+
+	key.round = tap_round_current;
+	key.name = (char *)name;
+	base = bsearch(&key, tap_baseline.entries, tap_baseline.nmemb, 
+			sizeof key, tap_baseline_key_cmp);
+	if (base == NULL) {
+		return skip_f(1, "No baseline of %s", name);
+	}
+
+	/* Medians are compared, the allowed noise is derived from the
+	   spread of samples of both runs */
+	noise = TAP_BASELINE_SIGMAS * TAP_BASELINE_MAD_SIGMA * 
+			TAP_BASELINE_MEDIAN_SE * 
+			sqrt(stats->mad * stats->mad / stats->samples +
+			     base->mad * base->mad / base->samples);
+	limit = base->median * (1 + tolerance) + noise;
+	ok = stats->median <= limit;
+
+	if (!ok) {
+		diag("    %s is slower than its baseline, median %.2f ns "
+				"exceeds %.2f ns", name, stats->median, limit);
+		ok = tap_baseline_mode == TAP_BASELINE_WARN;
+	}
+
+	return tap_bench_compare_result(ok, stats->median, limit, "<=", 
+			func, file, line, "%s is not slower than its baseline", 
+			name);
+}
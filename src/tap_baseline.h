@@ -0,0 +1,50 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_BASELINE_H
+#define TAP_BASELINE_H
+
+/** What ok_faster_than_baseline() does */
+enum tap_baseline_mode_e {
+	/** Fail, if the benchmark is slower than its baseline */
+	TAP_BASELINE_CHECK,
+	/** Only print a diagnostic message, if it's slower */
+	TAP_BASELINE_WARN,
+	/** Replace the baseline file by results of this run */
+	TAP_BASELINE_RECORD,
+	/** Store results of this run, keep baselines of tests not run */
+	TAP_BASELINE_UPDATE,
+};
+
+extern enum tap_baseline_mode_e tap_baseline_mode;
+
+extern const char *tap_baseline_file;
+
+void tap_baseline_init(void);
+
+void tap_baseline_finish(void);
+
+#endif // TAP_BASELINE_H
@@ -0,0 +1,317 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_bench.h"
+#include "tap_history.h"
+#include "tap_output.h"
+#include "tap_perf.h"
+#include "tap_round.h"
+#include "tap_sched.h"
+#include "tap.h"
+
+/** How long the cycle timer is calibrated against the monotonic clock */
+#define TAP_BENCH_CALIBRATE_NS 1000000ULL
+
+/** Samples collected by every benchmark */
+unsigned int tap_bench_samples = 30;
+
+/** Minimal duration of one sample */
+unsigned long long tap_bench_sample_ns = 1000000ULL;
+
+/** Statistics of the last benchmark of the thread */
+static __thread tap_bench_stats_t tap_bench_last_stats;
+
+/** Statistics of the last benchmark of the thread or NULL */
+__thread const tap_bench_stats_t *tap_bench_last;
+
+/** Result of the cycle timer calibration */
+static double tap_bench_ns_per_cycle;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_once_t tap_bench_once = PTHREAD_ONCE_INIT;
+#else
+static int tap_bench_once;
+#endif
+
+/** State of a running benchmark, the public part is first */
+typedef struct tap_bench_state_s {
+	tap_bench_t pub;
+	/** Iterations of the sample */
+	unsigned long iterations;
+	/** True, until a sample takes at least tap_bench_sample_ns */
+	int calibrating;
+	/** Cycle timer value, when the sample started */
+	unsigned long long start;
+	/** Hardware counters, when the first sample started */
+	tap_perf_counts_t perf;
+	const char *func;
+	const char *file;
+	unsigned int line;
+	/** Name of the test, usable as a format without arguments */
+	tap_line_t name;
+	unsigned int count;
+	/** Durations of samples in ns per iteration */
+	double samples[];
+} tap_bench_state_t;
+
+unsigned long long tap_bench_clock(void)
+{
+	return tap_sched_now();
+}
+
+static void tap_bench_calibrate(void)
+{
+	unsigned long long ns_start, ns_end, cycles_start, cycles_end;
+
+	ns_start = tap_sched_now();
+	cycles_start = tap_bench_cycles();
+	do {
+		ns_end = tap_sched_now();
+	} while (ns_end - ns_start < TAP_BENCH_CALIBRATE_NS);
+	cycles_end = tap_bench_cycles();
+
+	tap_bench_ns_per_cycle = cycles_end > cycles_start ? 
+			(double)(ns_end - ns_start) / 
+			(cycles_end - cycles_start) : 1;
+}
+
+/** Convert a difference of tap_bench_cycles() values to ns 
+ *
+ * The timer is calibrated against CLOCK_MONOTONIC on the first use.
+ */
+double tap_bench_ns(unsigned long long cycles)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_once(&tap_bench_once, tap_bench_calibrate);
+#else
+	if (!tap_bench_once) {
+		tap_bench_once = 1;
+		tap_bench_calibrate();
+	}
+#endif
+	return cycles * tap_bench_ns_per_cycle;
+}
+
+/** Start a benchmark, see TAP_BENCH */
+tap_bench_t *tap_bench_start(const char *func, const char *file, 
+		unsigned int line, const char *fmt, ...)
+{
+	tap_bench_state_t *bench;
+	tap_line_t name;
+	const char *c;
+	va_list ap;
+
+	if (tap_bench_samples == 0) {
+		tap_bench_samples = 1;
+	}
+
+	bench = malloc(sizeof *bench + 
+			tap_bench_samples * sizeof bench->samples[0]);
+	if (bench == NULL) {
+		BAIL_OUT("Not enough memory for a benchmark");
+	}
+
+	bench->iterations = 1;
+	bench->calibrating = 1;
+	bench->func = func;
+	bench->file = file;
+	bench->line = line;
+	bench->count = 0;
+
+	/* The name is formatted now, arguments may not be valid at the end */
+	tap_line_init(&bench->name);
+	if (fmt != NULL && *fmt != 0) {
+		tap_line_init(&name);
+		va_start(ap, fmt);
+		tap_line_vprintf(&name, fmt, ap);
+		va_end(ap);
+		for (c = name.buf; *c != '\0'; c++) {
+			if (*c == '%') {
+				tap_line_putc(&bench->name, '%');
+			}
+			tap_line_putc(&bench->name, *c);
+		}
+		tap_line_free(&name);
+	} else {
+		tap_line_printf(&bench->name, "%s:%d", func, line);
+	}
+
+	/* The timer is calibrated before the first sample starts */
+	tap_bench_ns(0);
+
+	bench->pub.left = bench->iterations;
+	bench->start = tap_bench_cycles();
+
+	return &bench->pub;
+}
+
+static int tap_bench_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/** Median of sorted values */
+static double tap_bench_median(const double *vals, unsigned int n)
+{
+	return n % 2 ? vals[n / 2] : (vals[n / 2 - 1] + vals[n / 2]) / 2;
+}
+
+/** Append statistics of the benchmark to the history */
+static void tap_bench_history(tap_bench_state_t *bench, 
+		const tap_bench_stats_t *stats)
+{
+	tap_history_rec_t rec;
+	const char *c;
+	unsigned int i;
+
+	memset(&rec, 0, sizeof rec);
+	rec.kind = TAP_HISTORY_BENCH;
+	rec.round = tap_round_current;
+	rec.iterations = stats->iterations;
+	rec.samples = stats->samples;
+	rec.min = stats->min;
+	rec.median = stats->median;
+	rec.mean = stats->mean;
+	rec.p99 = stats->p99;
+	rec.stddev = stats->stddev;
+	rec.mad = stats->mad;
+
+	/* The name is stored without escaping of '%' */
+	for (c = bench->name.buf, i = 0; *c && i < sizeof rec.name - 1; c++) {
+		if (c[0] == '%' && c[1] == '%') {
+			c++;
+		}
+		rec.name[i++] = *c;
+	}
+
+	tap_history_store(&rec);
+}
+
+/** Compute statistics of the benchmark and report it */
+static void tap_bench_finish(tap_bench_state_t *bench)
+{
+	tap_bench_stats_t *stats = &tap_bench_last_stats;
+	unsigned int i, n = bench->count;
+	double sum = 0, var = 0;
+	tap_perf_counts_t perf;
+
+	tap_perf_read(&perf);
+	tap_perf_delta(&perf, &bench->perf, &perf);
+	tap_perf_values(stats->perf, &perf, (double)n * bench->iterations);
+
+	qsort(bench->samples, n, sizeof bench->samples[0], tap_bench_cmp);
+
+	for (i = 0; i < n; i++) {
+		sum += bench->samples[i];
+	}
+
+	stats->mean = sum / n;
+	for (i = 0; i < n; i++) {
+		var += (bench->samples[i] - stats->mean) * 
+				(bench->samples[i] - stats->mean);
+	}
+
+	stats->min = bench->samples[0];
+	stats->median = tap_bench_median(bench->samples, n);
+	stats->p99 = bench->samples[(n * 99 + 99) / 100 - 1];
+	stats->stddev = n > 1 ? sqrt(var / (n - 1)) : 0;
+	stats->iterations = bench->iterations;
+	stats->samples = n;
+
+	/* Samples aren't needed anymore, they are replaced by deviations */
+	for (i = 0; i < n; i++) {
+		bench->samples[i] = fabs(bench->samples[i] - stats->median);
+	}
+	qsort(bench->samples, n, sizeof bench->samples[0], tap_bench_cmp);
+	stats->mad = tap_bench_median(bench->samples, n);
+
+	tap_bench_last = stats;
+	tap_bench_history(bench, stats);
+	tap_bench_result(stats, bench->func, bench->file, bench->line, 
+			bench->name.buf);
+
+	tap_line_free(&bench->name);
+	free(bench);
+}
+
+/** Finish a sample and decide, if the benchmark body should run again
+ *
+ * Samples of the calibration double the iterations until a sample takes
+ * tap_bench_sample_ns, they also warm up caches and branch predictors. Then
+ * tap_bench_samples samples are collected.
+ *
+ * @return 0 if the benchmark finished
+ */
+int tap_bench_next(tap_bench_t *pub)
+{
+	tap_bench_state_t *bench = (tap_bench_state_t *)pub;
+	double ns = tap_bench_ns(tap_bench_cycles() - bench->start);
+
+	if (bench->calibrating) {
+		if (ns < tap_bench_sample_ns && 
+		    bench->iterations < (unsigned long)-1 / 2) {
+			bench->iterations *= 2;
+		} else {
+			bench->calibrating = 0;
+			tap_perf_read(&bench->perf);
+		}
+	} else {
+		bench->samples[bench->count++] = ns / bench->iterations;
+		if (bench->count == tap_bench_samples) {
+			tap_bench_finish(bench);
+			return 0;
+		}
+	}
+
+	/* The caller runs one iteration right after the return */
+	bench->pub.left = bench->iterations - 1;
+	bench->start = tap_bench_cycles();
+
+	return 1;
+}
+
+/** Hardware event count per iteration of the last TAP_BENCH of the thread
+ * @return the count or -1 if the event wasn't counted
+ */
+double tap_bench_perf(tap_perf_event_t event)
+{
+	if (tap_bench_last == NULL) {
+		return -1;
+	}
+
+	return tap_bench_last->perf[event];
+}
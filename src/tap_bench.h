@@ -0,0 +1,62 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_BENCH_H
+#define TAP_BENCH_H
+
+#include "tap.h"
+
+/** Statistics of a benchmark, durations are in ns per iteration */
+typedef struct tap_bench_stats_s {
+	double min;
+	double median;
+	double mean;
+	double p99;
+	double stddev;
+	/** Median absolute deviation */
+	double mad;
+	/** Iterations of one sample */
+	unsigned long iterations;
+	unsigned int samples;
+	/** Hardware event counts per iteration, negative if not counted */
+	double perf[TAP_PERF_EVENTS];
+} tap_bench_stats_t;
+
+extern unsigned int tap_bench_samples;
+
+extern unsigned long long tap_bench_sample_ns;
+
+extern __thread const tap_bench_stats_t *tap_bench_last;
+
+unsigned int tap_bench_result(const tap_bench_stats_t *stats, 
+		const char *func, const char *file, unsigned int line, 
+		const char *name, ...);
+
+unsigned int tap_bench_compare_result(int ok, double got, double expected, 
+		const char *op, const char *func, const char *file, 
+		unsigned int line, const char *fmt, ...);
+
+#endif // TAP_BENCH_H
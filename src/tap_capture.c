@@ -0,0 +1,158 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "tap_capture.h"
+#include "tap_heap.h"
+
+/** Streamed captures are written out, when they grow over this size */
+#define TAP_CAPTURE_STREAM 4096
+
+/** Header of a captured record, the data follow it */
+struct tap_rec_hdr_s {
+	tap_rec_t kind;
+	size_t len;
+};
+
+__thread tap_capture_t *tap_capture = NULL;
+
+tap_capture_t *tap_capture_streamed = NULL;
+
+void tap_capture_init(tap_capture_t *capture)
+{
+	tap_line_init(&capture->buf);
+	capture->fd = -1;
+}
+
+void tap_capture_free(tap_capture_t *capture)
+{
+	tap_heap_ignore(1);
+	tap_line_free(&capture->buf);
+	tap_heap_ignore(0);
+}
+
+/** Append a record to the capture */
+void tap_capture_put(tap_capture_t *capture, tap_rec_t kind, 
+		const char *data, size_t len)
+{
+	struct tap_rec_hdr_s hdr = { .kind = kind, .len = len };
+
+	/* Captures are released after their round */
+	tap_heap_ignore(1);
+	tap_line_write(&capture->buf, (const char*)&hdr, sizeof hdr);
+	if (len) {
+		tap_line_write(&capture->buf, data, len);
+	}
+	tap_heap_ignore(0);
+
+	if (capture->fd >= 0 && capture->buf.len >= TAP_CAPTURE_STREAM) {
+		tap_capture_flush(capture);
+	}
+}
+
+/** Write records of a streamed capture out */
+void tap_capture_flush(tap_capture_t *capture)
+{
+	size_t pos = 0;
+	ssize_t rtn;
+	int old_errno = errno;
+
+	while (pos < capture->buf.len) {
+		rtn = write(capture->fd, capture->buf.buf + pos, 
+				capture->buf.len - pos);
+		if (rtn < 0 && errno == EINTR) {
+			continue;
+		} else if (rtn <= 0) {
+			break;
+		}
+		pos += rtn;
+	}
+
+	capture->buf.len = 0;
+	errno = old_errno;
+}
+
+static void tap_capture_signal(int sig)
+{
+	tap_capture_flush(tap_capture_streamed);
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void tap_capture_exit(void)
+{
+	tap_capture_flush(tap_capture_streamed);
+}
+
+/** Stream the capture to fd, records captured so far are written there
+ *  also when the process exits or is killed by a signal.
+ *
+ * Used by a forked process, which must not report anything by itself.
+ */
+void tap_capture_stream(tap_capture_t *capture, int fd)
+{
+	capture->fd = fd;
+	tap_capture_streamed = capture;
+
+	tap_output_catch(tap_capture_signal, 1);
+	atexit(tap_capture_exit);
+}
+
+/** Iterate over captured records
+ * @param capture - the capture
+ * @param pos - position in the capture, start with 0
+ * @param kind - kind of the record
+ * @param len - length of the record data
+ *
+ * @return the record data, NULL at the end of the capture
+ */
+const char *tap_capture_next(const tap_capture_t *capture, size_t *pos, 
+		tap_rec_t *kind, size_t *len)
+{
+	struct tap_rec_hdr_s hdr;
+	const char *data;
+
+	if (*pos + sizeof hdr > capture->buf.len) {
+		return NULL;
+	}
+
+	/* The rest of a record may be missing, if its writer died */
+	memcpy(&hdr, capture->buf.buf + *pos, sizeof hdr);
+	if (*pos + sizeof hdr + hdr.len > capture->buf.len) {
+		return NULL;
+	}
+	data = capture->buf.buf + *pos + sizeof hdr;
+	*pos += sizeof hdr + hdr.len;
+	*kind = hdr.kind;
+	*len = hdr.len;
+
+	return data;
+}
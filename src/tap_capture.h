@@ -0,0 +1,77 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_CAPTURE_H
+#define TAP_CAPTURE_H
+
+#include <stddef.h>
+
+#include "tap_output.h"
+
+/** Kinds of captured records */
+typedef enum tap_rec_e {
+	TAP_REC_OUT,      /* Text for stdout */
+	TAP_REC_ERR,      /* Text for stderr */
+	TAP_REC_PASS,     /* Passed test, which can be compressed */
+	TAP_REC_OK,       /* Passed test, data follow the test number */
+	TAP_REC_NOT_OK,   /* Failed test, data follow the test number */
+	TAP_REC_TODO,     /* Failed TODO test, data follow the test number */
+	TAP_REC_BAIL,     /* Bail out message */
+	TAP_REC_END,      /* The capture is complete */
+} tap_rec_t;
+
+/** Output of a thread collected for later */
+typedef struct tap_capture_s {
+	tap_line_t buf;
+	/** Descriptor the capture is streamed to or -1 */
+	int fd;
+} tap_capture_t;
+
+/** Capture of the current thread, NULL if the output is written directly */
+extern __thread tap_capture_t *tap_capture;
+
+/** Capture streamed by this process, NULL if there is none */
+extern tap_capture_t *tap_capture_streamed;
+
+void tap_capture_init(tap_capture_t *capture);
+
+void tap_capture_free(tap_capture_t *capture);
+
+void tap_capture_put(tap_capture_t *capture, tap_rec_t kind, 
+		const char *data, size_t len);
+
+void tap_capture_stream(tap_capture_t *capture, int fd);
+
+void tap_capture_flush(tap_capture_t *capture);
+
+const char *tap_capture_next(const tap_capture_t *capture, size_t *pos, 
+		tap_rec_t *kind, size_t *len);
+
+/* From tap.c */
+
+void tap_capture_emit(const tap_capture_t *capture);
+
+#endif // TAP_CAPTURE_H
@@ -0,0 +1,167 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_alloc.h"
+#include "tap_heap.h"
+#include "tap_main.h"
+#include "tap.h"
+
+/* Heap usage is known only, if the test uses libtap-alloc */
+#pragma weak tap_alloc_thread
+
+/** Rounds with the largest peak reported at the end */
+#define TAP_HEAP_TOP 10
+
+/** Heap usage of a round */
+struct tap_heap_s {
+	unsigned long round;
+	unsigned long long allocs;
+	unsigned long long bytes;
+	long long peak;
+	long long leaked;
+};
+
+/** Usage of the thread at the start of its round */
+static __thread tap_alloc_counts_t tap_heap_start;
+
+/** Rounds with the largest peak, the largest one first */
+static struct tap_heap_s tap_heap_top[TAP_HEAP_TOP];
+
+static unsigned int tap_heap_count;
+
+/** Rounds, which didn't free all memory they allocated */
+static unsigned int tap_heap_leaks;
+
+static long long tap_heap_leaked;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t tap_heap_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/** Count the heap usage of the round from now */
+void tap_heap_round_start(void)
+{
+	tap_alloc_counts_t *counts;
+
+	if (!tap_alloc_thread) {
+		return;
+	}
+
+	counts = tap_alloc_thread();
+	counts->peak = counts->live;
+	tap_heap_start = *counts;
+}
+
+/** Account the heap usage of the round, which just finished
+ *
+ * Leaking rounds are reported immediately, other ones only with -v.
+ */
+void tap_heap_round_done(unsigned long round)
+{
+	tap_alloc_counts_t *counts;
+	struct tap_heap_s heap;
+	unsigned int i;
+
+	if (!tap_alloc_thread) {
+		return;
+	}
+
+	counts = tap_alloc_thread();
+	heap.round = round;
+	heap.allocs = counts->allocs - tap_heap_start.allocs;
+	heap.bytes = counts->bytes - tap_heap_start.bytes;
+	heap.peak = counts->peak - tap_heap_start.live;
+	heap.leaked = counts->live - tap_heap_start.live;
+
+	if (heap.leaked > 0 || tap_verbose) {
+		diag("Round %lu: %llu allocations, %llu B allocated, peak "
+				"%lld B, leaked %lld B", round, heap.allocs, 
+				heap.bytes, heap.peak, heap.leaked);
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&tap_heap_lock);
+#endif
+	if (heap.leaked > 0) {
+		tap_heap_leaks++;
+		tap_heap_leaked += heap.leaked;
+	}
+	if (tap_heap_count < TAP_HEAP_TOP || 
+	    heap.peak > tap_heap_top[tap_heap_count - 1].peak) {
+		if (tap_heap_count < TAP_HEAP_TOP) {
+			tap_heap_count++;
+		}
+		for (i = tap_heap_count - 1; 
+				i > 0 && tap_heap_top[i - 1].peak < heap.peak; i--) {
+			tap_heap_top[i] = tap_heap_top[i - 1];
+		}
+		tap_heap_top[i] = heap;
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&tap_heap_lock);
+#endif
+}
+
+/** Print the table of rounds with the largest heap usage
+ *
+ * Rounds executed by forked processes (-f) aren't included.
+ */
+void tap_heap_report(void)
+{
+	unsigned int i;
+
+	if (tap_heap_count == 0) {
+		return;
+	}
+
+	diag("Rounds with the largest heap usage:");
+	diag("    %8s %12s %14s %12s %12s", "round", "allocations", 
+			"allocated [B]", "peak [B]", "leaked [B]");
+	for (i = 0; i < tap_heap_count; i++) {
+		diag("    %8lu %12llu %14llu %12lld %12lld", 
+				tap_heap_top[i].round, tap_heap_top[i].allocs,
+				tap_heap_top[i].bytes, tap_heap_top[i].peak, 
+				tap_heap_top[i].leaked);
+	}
+	if (tap_heap_leaks) {
+		diag("%u rounds leaked %lld B", tap_heap_leaks, 
+				tap_heap_leaked);
+	}
+}
+
+/** Don't count allocations of the library, which outlive the round
+ * @param ignore - 1 to stop counting, 0 to count again, calls nest
+ */
+void tap_heap_ignore(int ignore)
+{
+	if (tap_alloc_thread) {
+		tap_alloc_thread()->ignore += ignore ? 1 : -1;
+	}
+}
@@ -0,0 +1,540 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* History of benchmarks and durations of parameters sets
+ *
+ * Every run appends records to the history file. Records of one key are
+ * linked from the newest to the oldest one and the index file <history>.idx
+ * maps keys to their newest records, so appending is O(1) and reading the
+ * last N runs of a benchmark is O(N). The index is brought up to date from
+ * the history, when it's opened, it may be deleted to be rebuilt.
+ */
+
+/* For dl_iterate_phdr() */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_history.h"
+
+/** Magic of the index file */
+#define TAP_HISTORY_MAGIC "TAPHIDX1"
+
+/** Buckets of a new index */
+#define TAP_HISTORY_BUCKETS 1024
+
+/** History file or NULL if the history isn't stored */
+const char *tap_history_file;
+
+/** Start of this run and the build ID of the binary */
+static tap_history_rec_t tap_history_run;
+
+/** True, once the build ID is known */
+static int tap_history_identified;
+
+/** History of this run, it's opened by the first record stored */
+static tap_history_t tap_history_this = {.fd = -1, .idx_fd = -1};
+
+/** 1 if tap_history_this is open, -1 if it can't be opened */
+static int tap_history_state;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t tap_history_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static uint64_t tap_history_fnv(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *c = data;
+
+	while (len--) {
+		hash = (hash ^ *c++) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/** Hash of the key of a record */
+uint64_t tap_history_hash(uint32_t kind, int64_t round, const char *name)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	hash = tap_history_fnv(hash, &kind, sizeof kind);
+	hash = tap_history_fnv(hash, &round, sizeof round);
+
+	return tap_history_fnv(hash, name, strlen(name));
+}
+
+static int tap_history_pread(int fd, void *buf, size_t len, uint64_t offset)
+{
+	return pread(fd, buf, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+static int tap_history_pwrite(int fd, const void *buf, size_t len, 
+		uint64_t offset)
+{
+	return pwrite(fd, buf, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+static uint64_t tap_history_bucket_offset(uint64_t i)
+{
+	return sizeof(tap_history_idx_t) + i * sizeof(tap_history_bucket_t);
+}
+
+/** Create an empty index of the given size */
+static int tap_history_idx_create(int fd, tap_history_idx_t *idx, 
+		uint64_t size)
+{
+	memcpy(idx->magic, TAP_HISTORY_MAGIC, sizeof idx->magic);
+	idx->size = size;
+	idx->keys = 0;
+	idx->records = 0;
+
+	if (ftruncate(fd, 0) || ftruncate(fd, tap_history_bucket_offset(size))) {
+		return -1;
+	}
+
+	return tap_history_pwrite(fd, idx, sizeof *idx, 0);
+}
+
+/** Find the bucket of the hash, it's the free one if the hash isn't there */
+static int64_t tap_history_probe(tap_history_t *history, uint64_t hash, 
+		tap_history_bucket_t *bucket)
+{
+	uint64_t i, mask = history->idx.size - 1;
+
+	for (i = hash & mask; ; i = (i + 1) & mask) {
+		if (tap_history_bucket(history, i, bucket)) {
+			return -1;
+		}
+		if (bucket->offset == 0 || bucket->hash == hash) {
+			return i;
+		}
+	}
+}
+
+/** Double the index, the new one replaces the old one atomically */
+static int tap_history_grow(tap_history_t *history)
+{
+	tap_history_bucket_t *old, *new;
+	tap_history_idx_t idx = history->idx;
+	uint64_t i, j, mask;
+	char *tmp;
+	int fd, rtn = -1;
+
+	old = malloc(idx.size * sizeof *old);
+	new = calloc(2 * idx.size, sizeof *new);
+	tmp = malloc(strlen(history->idx_file) + sizeof ".tmp");
+	if (old == NULL || new == NULL || tmp == NULL || 
+	    tap_history_pread(history->idx_fd, old, idx.size * sizeof *old, 
+			tap_history_bucket_offset(0))) {
+		goto out;
+	}
+
+	mask = 2 * idx.size - 1;
+	for (i = 0; i < idx.size; i++) {
+		if (old[i].offset == 0) {
+			continue;
+		}
+		for (j = old[i].hash & mask; new[j].offset; j = (j + 1) & mask);
+		new[j] = old[i];
+	}
+	idx.size *= 2;
+
+	sprintf(tmp, "%s.tmp", history->idx_file);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		goto out;
+	}
+
+	if (tap_history_pwrite(fd, &idx, sizeof idx, 0) ||
+	    tap_history_pwrite(fd, new, idx.size * sizeof *new, 
+			tap_history_bucket_offset(0)) ||
+	    rename(tmp, history->idx_file)) {
+		close(fd);
+		unlink(tmp);
+		goto out;
+	}
+
+	close(history->idx_fd);
+	history->idx_fd = fd;
+	history->idx = idx;
+	rtn = 0;
+out:
+	free(old);
+	free(new);
+	free(tmp);
+	return rtn;
+}
+
+/** Point the key of the hash to the record at offset */
+static int tap_history_insert(tap_history_t *history, uint64_t hash, 
+		uint64_t offset)
+{
+	tap_history_bucket_t bucket;
+	int64_t i;
+
+	if (2 * (history->idx.keys + 1) > history->idx.size && 
+	    tap_history_grow(history)) {
+		return -1;
+	}
+
+	i = tap_history_probe(history, hash, &bucket);
+	if (i < 0) {
+		return -1;
+	}
+
+	if (bucket.offset == 0) {
+		history->idx.keys++;
+	}
+	bucket.hash = hash;
+	bucket.offset = offset + 1;
+
+	return tap_history_pwrite(history->idx_fd, &bucket, sizeof bucket, 
+			tap_history_bucket_offset(i));
+}
+
+/** Index records appended since the index was written last time */
+static int tap_history_catch_up(tap_history_t *history)
+{
+	tap_history_rec_t rec;
+	struct stat st;
+	uint64_t records;
+
+	if (fstat(history->fd, &st)) {
+		return -1;
+	}
+
+	/* A partially written record is ignored and overwritten later */
+	records = st.st_size / sizeof rec;
+	if (records == history->idx.records) {
+		return 0;
+	}
+
+	if (records < history->idx.records) {
+		/* The history was replaced, the index is rebuilt */
+		if (tap_history_idx_create(history->idx_fd, &history->idx, 
+				TAP_HISTORY_BUCKETS)) {
+			return -1;
+		}
+	}
+
+	for (; history->idx.records < records; history->idx.records++) {
+		if (tap_history_read(history, 
+				history->idx.records * sizeof rec, &rec) ||
+		    tap_history_insert(history, rec.hash, 
+				history->idx.records * sizeof rec)) {
+			return -1;
+		}
+	}
+
+	return tap_history_pwrite(history->idx_fd, &history->idx, 
+			sizeof history->idx, 0);
+}
+
+/** Bring the index up to date, the history must be locked
+ *
+ * The index is reopened, if it was deleted or replaced by another process.
+ */
+static int tap_history_sync(tap_history_t *history, int writable)
+{
+	struct stat st, idx_st;
+	int update = 1;
+
+	if (history->idx_fd >= 0 && (stat(history->idx_file, &st) ||
+	    fstat(history->idx_fd, &idx_st) || st.st_ino != idx_st.st_ino || 
+	    st.st_dev != idx_st.st_dev)) {
+		close(history->idx_fd);
+		history->idx_fd = -1;
+	}
+
+	if (history->idx_fd < 0) {
+		history->idx_fd = open(history->idx_file, O_RDWR | O_CREAT, 
+				0666);
+		if (history->idx_fd < 0 && !writable) {
+			history->idx_fd = open(history->idx_file, O_RDONLY);
+			update = 0;
+		}
+		if (history->idx_fd < 0) {
+			return -1;
+		}
+	}
+
+	if (tap_history_pread(history->idx_fd, &history->idx, 
+			sizeof history->idx, 0) ||
+	    memcmp(history->idx.magic, TAP_HISTORY_MAGIC, 
+			sizeof history->idx.magic)) {
+		if (!update || tap_history_idx_create(history->idx_fd, 
+				&history->idx, TAP_HISTORY_BUCKETS)) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	return update ? tap_history_catch_up(history) : 0;
+}
+
+/** Open and lock the history, the index is brought up to date
+ * @param writable - true to append records
+ *
+ * Readers update the index too, if they are allowed to write it, records
+ * which aren't indexed aren't visible otherwise.
+ *
+ * @return 0 on success, -1 and errno on failure
+ */
+int tap_history_open(tap_history_t *history, const char *file, int writable)
+{
+	history->file = file;
+	history->idx_fd = -1;
+	history->idx_file = malloc(strlen(file) + sizeof ".idx");
+	if (history->idx_file == NULL) {
+		return -1;
+	}
+	sprintf(history->idx_file, "%s.idx", file);
+
+	history->fd = open(file, writable ? O_RDWR | O_CREAT : O_RDONLY, 0666);
+	if (history->fd < 0 || flock(history->fd, LOCK_EX) ||
+	    tap_history_sync(history, writable)) {
+		tap_history_close(history);
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Close the history, it unlocks it */
+void tap_history_close(tap_history_t *history)
+{
+	if (history->idx_fd >= 0) {
+		close(history->idx_fd);
+	}
+	if (history->fd >= 0) {
+		close(history->fd);
+	}
+	history->idx_fd = history->fd = -1;
+	free(history->idx_file);
+	history->idx_file = NULL;
+}
+
+/** Read the record at the offset */
+int tap_history_read(tap_history_t *history, uint64_t offset, 
+		tap_history_rec_t *rec)
+{
+	return tap_history_pread(history->fd, rec, sizeof *rec, offset);
+}
+
+/** Read the i-th bucket of the index */
+int tap_history_bucket(tap_history_t *history, uint64_t i, 
+		tap_history_bucket_t *bucket)
+{
+	return tap_history_pread(history->idx_fd, bucket, sizeof *bucket, 
+			tap_history_bucket_offset(i));
+}
+
+/** Offset of the newest record of the key or TAP_HISTORY_NONE */
+uint64_t tap_history_find(tap_history_t *history, uint64_t hash)
+{
+	tap_history_bucket_t bucket;
+
+	if (tap_history_probe(history, hash, &bucket) < 0 || 
+	    bucket.offset == 0) {
+		return TAP_HISTORY_NONE;
+	}
+
+	return bucket.offset - 1;
+}
+
+/** Append the record, its hash and link to the previous record are set */
+int tap_history_append(tap_history_t *history, tap_history_rec_t *rec)
+{
+	uint64_t offset = history->idx.records * sizeof *rec;
+
+	rec->hash = tap_history_hash(rec->kind, rec->round, rec->name);
+	rec->prev = tap_history_find(history, rec->hash);
+
+	if (tap_history_pwrite(history->fd, rec, sizeof *rec, offset) ||
+	    tap_history_insert(history, rec->hash, offset)) {
+		return -1;
+	}
+	history->idx.records++;
+
+	return tap_history_pwrite(history->idx_fd, &history->idx, 
+			sizeof history->idx, 0);
+}
+
+/** Find the GNU build ID of the executable */
+static int tap_history_build_id_cb(struct dl_phdr_info *info, size_t size, 
+		void *data)
+{
+	const ElfW(Nhdr) *note;
+	const char *pos, *end;
+	int i;
+
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		if (info->dlpi_phdr[i].p_type != PT_NOTE) {
+			continue;
+		}
+
+		pos = (const char *)info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+		end = pos + info->dlpi_phdr[i].p_memsz;
+		while (pos + sizeof *note <= end) {
+			note = (const ElfW(Nhdr) *)pos;
+			pos += sizeof *note + ((note->n_namesz + 3) & ~3);
+			if (note->n_type == NT_GNU_BUILD_ID && 
+			    note->n_namesz == 4 && 
+			    !memcmp(note + 1, "GNU", 4)) {
+				tap_history_run.build_id_len = 
+					note->n_descsz < TAP_HISTORY_BUILD_ID ?
+					note->n_descsz : TAP_HISTORY_BUILD_ID;
+				memcpy(tap_history_run.build_id, pos, 
+					tap_history_run.build_id_len);
+				return 1;
+			}
+			pos += (note->n_descsz + 3) & ~3;
+		}
+	}
+
+	/* The executable is the first object, others aren't searched */
+	return 1;
+}
+
+/** Find the build ID of the executable
+ *
+ * Binaries linked without a build ID are identified by a hash of their
+ * content.
+ */
+static void tap_history_identify(void)
+{
+	char buf[4096];
+	uint64_t hash;
+	ssize_t len;
+	int fd;
+
+	tap_history_identified = 1;
+
+	dl_iterate_phdr(tap_history_build_id_cb, NULL);
+	if (tap_history_run.build_id_len) {
+		return;
+	}
+
+	fd = open("/proc/self/exe", O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	hash = 14695981039346656037ULL;
+	while ((len = read(fd, buf, sizeof buf)) > 0) {
+		hash = tap_history_fnv(hash, buf, len);
+	}
+	close(fd);
+
+	memcpy(tap_history_run.build_id, &hash, sizeof hash);
+	tap_history_run.build_id_len = sizeof hash;
+}
+
+#ifdef HAVE_LIBPTHREAD
+/** Forked processes open the history again, they would share the lock */
+static void tap_history_fork_child(void)
+{
+	pthread_mutex_init(&tap_history_lock, NULL);
+	if (tap_history_state > 0) {
+		tap_history_close(&tap_history_this);
+	}
+	tap_history_state = 0;
+}
+#endif
+
+/** Remember the start of the run, it must be called before rounds are
+ *  forked. The history is opened by the first record stored. */
+void tap_history_init(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	tap_history_run.run = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_atfork(NULL, NULL, tap_history_fork_child);
+#endif
+}
+
+/** Append the record to the history of this run, if it's enabled
+ *
+ * The run and the build ID are filled in, failures are ignored, the history
+ * doesn't change results of tests. The history stays open till the exit, 
+ * it's locked only while the record is appended.
+ */
+void tap_history_store(tap_history_rec_t *rec)
+{
+	tap_history_t *history = &tap_history_this;
+
+	if (tap_history_file == NULL) {
+		return;
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&tap_history_lock);
+#endif
+	if (tap_history_run.run == 0) {
+		tap_history_init();
+	}
+	if (!tap_history_identified) {
+		tap_history_identify();
+	}
+	rec->run = tap_history_run.run;
+	rec->build_id_len = tap_history_run.build_id_len;
+	memcpy(rec->build_id, tap_history_run.build_id, 
+			sizeof rec->build_id);
+
+	if (tap_history_state == 0) {
+		tap_history_state = tap_history_open(history, 
+				tap_history_file, 1) ? -1 : 1;
+	} else if (tap_history_state > 0 && (flock(history->fd, LOCK_EX) ||
+			tap_history_sync(history, 1))) {
+		flock(history->fd, LOCK_UN);
+		tap_history_state = -1;
+		tap_history_close(history);
+	}
+
+	if (tap_history_state > 0) {
+		tap_history_append(history, rec);
+		flock(history->fd, LOCK_UN);
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&tap_history_lock);
+#endif
+}
@@ -0,0 +1,127 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_HISTORY_H
+#define TAP_HISTORY_H
+
+#include <stdint.h>
+
+/** Longest stored name of a benchmark, longer names are truncated */
+#define TAP_HISTORY_NAME 128
+
+/** Longest stored build ID, it's 20 bytes long for SHA1 build IDs */
+#define TAP_HISTORY_BUILD_ID 20
+
+/** Value of prev, if the record is the first one of its key */
+#define TAP_HISTORY_NONE UINT64_MAX
+
+/** Kinds of records */
+enum tap_history_kind_e {
+	/** Statistics of TAP_BENCH */
+	TAP_HISTORY_BENCH,
+	/** Duration of a parameters set, only median is valid */
+	TAP_HISTORY_ROUND,
+};
+
+/** Record of the history file, the file is an array of records
+ *
+ * Records of one key (kind, round and name) are linked from the newest one
+ * to the oldest one, so the last N runs are read in O(N).
+ */
+typedef struct tap_history_rec_s {
+	/** Offset of the previous record of the key or TAP_HISTORY_NONE */
+	uint64_t prev;
+	/** Hash of the key */
+	uint64_t hash;
+	/** Start of the run in ns since the epoch */
+	uint64_t run;
+	/** Parameters set or -1 */
+	int64_t round;
+	uint64_t iterations;
+	double min;
+	double median;
+	double mean;
+	double p99;
+	double stddev;
+	double mad;
+	uint32_t kind;
+	uint32_t samples;
+	uint32_t build_id_len;
+	uint8_t build_id[TAP_HISTORY_BUILD_ID];
+	char name[TAP_HISTORY_NAME];
+} tap_history_rec_t;
+
+/** Header of the index file, buckets of the hash table follow */
+typedef struct tap_history_idx_s {
+	char magic[8];
+	/** Number of buckets, a power of 2 */
+	uint64_t size;
+	/** Number of used buckets */
+	uint64_t keys;
+	/** Records of the history file, which are indexed */
+	uint64_t records;
+} tap_history_idx_t;
+
+/** Bucket of the index, it points to the newest record of the key */
+typedef struct tap_history_bucket_s {
+	uint64_t hash;
+	/** Offset of the record plus one, 0 if the bucket is free */
+	uint64_t offset;
+} tap_history_bucket_t;
+
+/** Opened history and its index */
+typedef struct tap_history_s {
+	int fd;
+	int idx_fd;
+	const char *file;
+	/** Name of the index file */
+	char *idx_file;
+	tap_history_idx_t idx;
+} tap_history_t;
+
+extern const char *tap_history_file;
+
+uint64_t tap_history_hash(uint32_t kind, int64_t round, const char *name);
+
+int tap_history_open(tap_history_t *history, const char *file, int writable);
+
+void tap_history_close(tap_history_t *history);
+
+int tap_history_append(tap_history_t *history, tap_history_rec_t *rec);
+
+uint64_t tap_history_find(tap_history_t *history, uint64_t hash);
+
+int tap_history_read(tap_history_t *history, uint64_t offset, 
+		tap_history_rec_t *rec);
+
+int tap_history_bucket(tap_history_t *history, uint64_t i, 
+		tap_history_bucket_t *bucket);
+
+void tap_history_init(void);
+
+void tap_history_store(tap_history_rec_t *rec);
+
+#endif // TAP_HISTORY_H
@@ -25,12 +25,18 @@
  */
 
 #include <unistd.h>
+#include <getopt.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
 #include "tap_params.h"
+#include "tap_round.h"
+#include "tap_bench.h"
+#include "tap_baseline.h"
+#include "tap_history.h"
+#include "tap_repeat.h"
 #include "tap.h"
 
 extern char __start___tap_info[];
@@ -45,13 +51,70 @@ Options:\n\
   -p param=value .. Override value of parameter 'param'\n\
   -r range ........ Execute only for parameters specified by range (eg: 2,7-11,15)\n\
   -c count ........ Execute the test count times for every parameters set.\n\
+  -d file ......... Read parameters sets from CSV file, its first line names\n\
+                    parameters and every other line is one parameters set\n\
+  -j jobs ......... Execute parameters sets by jobs threads in parallel, the\n\
+                    output of sets done far ahead of the sets preceding them\n\
+                    waits in a temporary file\n\
+  -f .............. Execute every parameters set in a separate process, with\n\
+                    -j jobs processes run in parallel\n\
+  -T file ......... Schedule parallel parameters sets by durations stored in\n\
+                    file (default: <test>.timings, if it exists)\n\
+  --shard i/n ..... Execute only parameters sets of the i-th of n shards, the\n\
+                    first one is 1. Outputs can be joined by tap-merge.\n\
+  --cover t ....... Execute only parameters sets of a covering array, which\n\
+                    contains every combination of values of t axes of the\n\
+                    TAP_PARAMS_MATRIX at least once (2 for pairwise)\n\
+  --seed n ........ Seed of the covering array generator (default: 0)\n\
+  --timing[=pass] . Add durations of tests to YAMLish blocks of failed tests,\n\
+                    with =pass passed tests get the blocks too\n\
+  --perf .......... Add hardware event counts of tests to YAMLish blocks and\n\
+                    to TAP_BENCH results, print counts of parameters sets\n\
+  --rusage ........ Add CPU times, page faults, context switches and I/O of\n\
+                    tests to YAMLish blocks, print them for parameters sets\n\
+                    (-v prints them too)\n\
+  --slowest n ..... Print the table of the n slowest parameters sets\n\
+  --repeat n ...... Execute every parameters set n times and report it by one\n\
+                    test with its flake rate and durations, TAP_FLAGS_REPEAT_*\n\
+                    set it too\n\
+  --bench-samples n Samples collected by every TAP_BENCH (default: 30)\n\
+  --bench-time us . Minimal duration of one TAP_BENCH sample in microseconds\n\
+                    (default: 1000)\n\
+  --baseline file . Baseline of ok_faster_than_baseline (default:\n\
+                    <test>.baseline), only the record and update modes\n\
+                    write it\n\
+  --baseline-mode m What ok_faster_than_baseline does: 'check' fails slower\n\
+                    tests (default), 'warn' only reports them, 'record'\n\
+                    replaces the baseline, 'update' stores results of tests\n\
+                    run and keeps others\n\
+  --history file .. Append results of benchmarks and with --timing or\n\
+                    --slowest durations of parameters sets to the history\n\
+                    read by tap-history (default: <test>.history, if it\n\
+                    exists)\n\
+  --no-history .... Don't append results to the history\n\
   -h .............. Print this message\n\
 \n\
 Variables:\n\
   HARNESS_ACTIVE .. If set, newline will be printed on stderr if test fails\n\
 ";
 
-int tap_params_override_active = 0;
+static const struct option opt_long[] = {
+	{"shard", required_argument, NULL, 'S'},
+	{"cover", required_argument, NULL, 'C'},
+	{"seed", required_argument, NULL, 'R'},
+	{"timing", optional_argument, NULL, 'M'},
+	{"perf", no_argument, NULL, 'P'},
+	{"rusage", no_argument, NULL, 'G'},
+	{"slowest", required_argument, NULL, 'W'},
+	{"repeat", required_argument, NULL, 'E'},
+	{"bench-samples", required_argument, NULL, 'B'},
+	{"bench-time", required_argument, NULL, 'U'},
+	{"baseline", required_argument, NULL, 'L'},
+	{"baseline-mode", required_argument, NULL, 'K'},
+	{"history", required_argument, NULL, 'H'},
+	{"no-history", no_argument, NULL, 'N'},
+	{NULL, 0, NULL, 0},
+};
 
 int tap_verbose = 0;
 
@@ -59,6 +122,10 @@ char tap_params_def[] __attribute__ ((weak)) = "";
 
 char tap_params_values_def[] __attribute__ ((weak)) = "";
 
+tap_param_desc_t *const tap_params_desc[2] __attribute__ ((weak));
+
+tap_params_axis_t *const tap_params_axes[2] __attribute__ ((weak));
+
 void *tap_params_values[1] __attribute__ ((weak));
 
 unsigned long tap_params_size __attribute__ ((weak)) = 0;
@@ -67,7 +134,7 @@ unsigned long tap_params_values_nmemb __attribute__ ((weak)) = 0;
 
 unsigned long tap_flags __attribute__ ((weak)) = TAP_FLAGS_DEFAULT;
 
-void *tap_params_current __attribute__ ((weak));
+__thread void *tap_params_current;
 
 struct record_s { char *name; int count; };
 
@@ -218,11 +285,33 @@ int tap_start(int argc, char *argv[])
 { 
 	int opt;
 	char *tmp;
+	char extra;
 	int count = 1;
+	int jobs = 1;
+	int isolate = 0;
+	char *timings = NULL;
+	char *baseline;
+	char *history = NULL;
+	bool no_history = false;
+	unsigned int shard = 0, shards = 0;
+	unsigned int cover = 0;
+	unsigned long seed = 0;
+	char *data = NULL;
+	char **ranges;
+	int nranges = 0, i;
+
+	ranges = calloc(argc, sizeof *ranges);
+	if (ranges == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
 
 	tap_params_init(tap_params_def);
+	tap_params_rounds(tap_params_values, tap_params_size, 
+			tap_params_values_nmemb);
 
-	while ((opt = getopt(argc, argv, "vhir:p:c:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "vhir:p:c:d:j:fT:", opt_long, 
+					NULL)) != -1) {
 		switch (opt) {
 			case 'h':
 				printf("Usage: %s [OPTIONS]\n%s\n", argv[0], opt_help);
@@ -239,7 +328,6 @@ int tap_start(int argc, char *argv[])
 				} else {
 					*tmp = '\0';
 					tap_param_override(optarg, tmp + 1);
-					tap_params_override_active = 1;
 				}
 				break;
 			case 'i':
@@ -249,17 +337,133 @@ int tap_start(int argc, char *argv[])
 				tap_verbose++;
 				break;
 			case 'r':
-				if (0 != tap_param_skip(optarg, tap_params_values, tap_params_size, tap_params_values_nmemb)) {
-					fprintf(stderr, "Option -r requires an "
+				/* Rounds are known once the data are read */
+				ranges[nranges++] = optarg;
+				break;
+			case 'd':
+				data = optarg;
+				break;
+			case 'c':
+				if (1 != sscanf(optarg, "%d%c", &count, &extra) || count < 1) {
+					fprintf(stderr, "Option -c requires an "
+							"integer argument (got '%s').\n", 
+							optarg);
+					exit(1);
+				}
+				break;
+			case 'f':
+				isolate = 1;
+				break;
+			case 'T':
+				timings = optarg;
+				break;
+			case 'S':
+				if (2 != sscanf(optarg, "%u/%u%c", &shard, &shards, &extra) ||
+				    shard < 1 || shard > shards) {
+					fprintf(stderr, "Option --shard requires an "
 							"argument in the format "
-							"[num|start-end][,num|start-end]..."
-							" (got '%s').\n", optarg);
+							"'shard/shards' (got '%s').\n", 
+							optarg);
 					exit(1);
 				}
 				break;
-			case 'c':
-				if (1 != sscanf(optarg, "%d%c", &count, &opt) || count < 1) {
-					fprintf(stderr, "Option -c requires an "
+			case 'C':
+				if (1 != sscanf(optarg, "%u%c", &cover, &extra) || cover < 1) {
+					fprintf(stderr, "Option --cover requires a "
+							"positive integer argument "
+							"(got '%s').\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'R':
+				if (1 != sscanf(optarg, "%lu%c", &seed, &extra)) {
+					fprintf(stderr, "Option --seed requires an "
+							"integer argument (got '%s').\n", 
+							optarg);
+					exit(1);
+				}
+				break;
+			case 'M':
+				if (optarg && strcmp(optarg, "pass")) {
+					fprintf(stderr, "Option --timing accepts "
+							"only 'pass' (got '%s').\n",
+							optarg);
+					exit(1);
+				}
+				tap_flags |= optarg ? TAP_FLAGS_TIMING_PASS : 
+						TAP_FLAGS_TIMING;
+				break;
+			case 'P':
+				tap_flags |= TAP_FLAGS_PERF;
+				break;
+			case 'G':
+				tap_flags |= TAP_FLAGS_RUSAGE;
+				break;
+			case 'W':
+				if (1 != sscanf(optarg, "%u%c", &tap_round_slowest, 
+							&extra)) {
+					fprintf(stderr, "Option --slowest requires "
+							"an integer argument (got '%s')."
+							"\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'E':
+				if (1 != sscanf(optarg, "%u%c", &tap_repeat, 
+							&extra) || tap_repeat < 1) {
+					fprintf(stderr, "Option --repeat requires "
+							"a positive integer argument (got "
+							"'%s').\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'B':
+				if (1 != sscanf(optarg, "%u%c", &tap_bench_samples, 
+							&extra) || tap_bench_samples < 1) {
+					fprintf(stderr, "Option --bench-samples requires "
+							"a positive integer argument (got "
+							"'%s').\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'U':
+				if (1 != sscanf(optarg, "%llu%c", &tap_bench_sample_ns, 
+							&extra)) {
+					fprintf(stderr, "Option --bench-time requires "
+							"an integer argument (got '%s')."
+							"\n", optarg);
+					exit(1);
+				}
+				tap_bench_sample_ns *= 1000;
+				break;
+			case 'L':
+				tap_baseline_file = optarg;
+				break;
+			case 'K':
+				if (!strcmp(optarg, "check")) {
+					tap_baseline_mode = TAP_BASELINE_CHECK;
+				} else if (!strcmp(optarg, "warn")) {
+					tap_baseline_mode = TAP_BASELINE_WARN;
+				} else if (!strcmp(optarg, "record")) {
+					tap_baseline_mode = TAP_BASELINE_RECORD;
+				} else if (!strcmp(optarg, "update")) {
+					tap_baseline_mode = TAP_BASELINE_UPDATE;
+				} else {
+					fprintf(stderr, "Option --baseline-mode accepts "
+							"check, warn, record or update "
+							"(got '%s').\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'H':
+				history = optarg;
+				break;
+			case 'N':
+				no_history = true;
+				break;
+			case 'j':
+				if (1 != sscanf(optarg, "%d%c", &jobs, &extra) || jobs < 1) {
+					fprintf(stderr, "Option -j requires an "
 							"integer argument (got '%s').\n", 
 							optarg);
 					exit(1);
@@ -268,10 +472,77 @@ int tap_start(int argc, char *argv[])
 		}
 	}
 
-	tap_params_main(tap_params_def, tap_params_values_def, 
-			tap_params_values, &tap_params_current,
-			tap_params_size, tap_params_values_nmemb, 
-			count);
+	if (data) {
+		if (jobs > 1 || isolate) {
+			fprintf(stderr, "Option -d can't be used with -j or "
+					"-f\n");
+			exit(1);
+		}
+		tap_params_data(data);
+	}
+
+	for (i = 0; i < nranges; i++) {
+		if (0 != tap_param_skip(ranges[i])) {
+			fprintf(stderr, "Option -r requires an "
+					"argument in the format "
+					"[num|start-end][,num|start-end]..."
+					" (got '%s').\n", ranges[i]);
+			exit(1);
+		}
+	}
+	free(ranges);
+
+	if (cover) {
+		tap_param_cover(cover, seed);
+	}
+
+	if (shards) {
+		tap_param_shard(shard - 1, shards, tap_params_values_def);
+	}
+
+	/* Durations of rounds are kept for the next parallel run, files next
+	   to the test aren't created unless asked for */
+	if (timings == NULL && jobs > 1) {
+		timings = malloc(strlen(argv[0]) + sizeof ".timings");
+		if (timings) {
+			sprintf(timings, "%s.timings", argv[0]);
+			if (access(timings, F_OK)) {
+				free(timings);
+				timings = NULL;
+			}
+		}
+	}
+
+	/* The baseline is next to the test too, it's read only unless it's
+	   recorded or updated */
+	if (tap_baseline_file == NULL) {
+		baseline = malloc(strlen(argv[0]) + sizeof ".baseline");
+		if (baseline) {
+			sprintf(baseline, "%s.baseline", argv[0]);
+			tap_baseline_file = baseline;
+		}
+	}
+	tap_baseline_init();
+
+	/* So is the history, if it exists, rounds forked later belong to this
+	   run */
+	if (history == NULL && !no_history) {
+		history = malloc(strlen(argv[0]) + sizeof ".history");
+		if (history) {
+			sprintf(history, "%s.history", argv[0]);
+			if (access(history, F_OK)) {
+				free(history);
+				history = NULL;
+			}
+		}
+	}
+	tap_history_file = no_history ? NULL : history;
+	tap_history_init();
+
+	tap_params_main(tap_params_values_def, count, jobs, 
+			isolate, timings);
+
+	tap_baseline_finish();
 
 	return exit_status();
 }
@@ -41,6 +41,10 @@ extern unsigned long tap_params_size;
 
 extern unsigned long tap_params_values_nmemb;
 
+extern __thread void *tap_params_current;
+
+void tap_main(int round);
+
 extern unsigned long tap_flags;
 
 #endif // TAP_MAIN_H
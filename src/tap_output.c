@@ -0,0 +1,573 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sched.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_output.h"
+
+/** Size of the stdout buffer used in the buffered mode */
+#define TAP_OUTPUT_BUFSIZE 65536
+
+/** Signals, which terminate the process and should not lose the output */
+static const int tap_output_signals[] = {
+	SIGHUP, SIGINT, SIGQUIT, SIGILL, SIGABRT, SIGFPE, SIGBUS, SIGSEGV,
+	SIGTERM,
+};
+
+/** True, if stdout is buffered */
+static int tap_output_buffered = 0;
+
+static char tap_output_buf[TAP_OUTPUT_BUFSIZE];
+
+static size_t tap_output_len = 0;
+
+__thread unsigned long long tap_output_thread_written;
+
+unsigned long long tap_output_written;
+
+#ifdef HAVE_LIBPTHREAD
+/** Size of the ring drained by the writer thread, must be a power of 2 */
+#define TAP_RING_SIZE (1 << 18)
+
+/** Records are aligned to the size of their header */
+#define TAP_RING_ALIGN(len) (((len) + 7) & ~(size_t)7)
+
+/** How many records are written by one writev() */
+#define TAP_RING_IOV 64
+
+/** How many times the writer looks for new records before it sleeps */
+#define TAP_RING_SPIN 64
+
+/** Descriptor of a record marking the unused end of the ring */
+#define TAP_RING_WRAP -1
+
+/** Header of a record in the ring, the data follow it */
+struct tap_ring_rec_s {
+	int fd;
+	unsigned int len;
+};
+
+/** True, if the output is written by the writer thread */
+static int tap_output_async = 0;
+
+static pthread_t tap_ring_writer;
+
+static char tap_ring[TAP_RING_SIZE] __attribute__ ((aligned (8)));
+
+/** Position, where the next record is stored, moved by the producer */
+static size_t tap_ring_head = 0;
+
+/** Position of the first record not written yet, moved by the writer */
+static size_t tap_ring_tail = 0;
+
+/** True, if the writer sleeps on tap_ring_cond */
+static int tap_ring_waiting = 0;
+
+static pthread_mutex_t tap_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t tap_ring_cond = PTHREAD_COND_INITIALIZER;
+#endif // HAVE_LIBPTHREAD
+
+/* Line composition *********************************************************/
+
+void tap_line_init(tap_line_t *line)
+{
+	line->buf = line->local;
+	line->len = 0;
+	line->size = sizeof line->local;
+	line->buf[0] = '\0';
+}
+
+void tap_line_free(tap_line_t *line)
+{
+	if (line->buf != line->local) {
+		free(line->buf);
+	}
+	tap_line_init(line);
+}
+
+/** Make sure there is space for at least need more characters and '\0' */
+static int tap_line_reserve(tap_line_t *line, size_t need)
+{
+	size_t size = line->size;
+	char *buf;
+
+	if (line->len + need < size) {
+		return 0;
+	}
+
+	while (line->len + need >= size) {
+		size *= 2;
+	}
+
+	if (line->buf == line->local) {
+		buf = malloc(size);
+		if (buf) {
+			memcpy(buf, line->buf, line->len + 1);
+		}
+	} else {
+		buf = realloc(line->buf, size);
+	}
+
+	if (buf == NULL) {
+		return -1;
+	}
+
+	line->buf = buf;
+	line->size = size;
+
+	return 0;
+}
+
+void tap_line_putc(tap_line_t *line, char c)
+{
+	if (tap_line_reserve(line, 1) == 0) {
+		line->buf[line->len++] = c;
+		line->buf[line->len] = '\0';
+	}
+}
+
+void tap_line_write(tap_line_t *line, const char *str, size_t len)
+{
+	if (tap_line_reserve(line, len) == 0) {
+		memcpy(line->buf + line->len, str, len);
+		line->len += len;
+		line->buf[line->len] = '\0';
+	}
+}
+
+void tap_line_puts(tap_line_t *line, const char *str)
+{
+	tap_line_write(line, str, strlen(str));
+}
+
+void tap_line_vprintf(tap_line_t *line, const char *fmt, va_list ap)
+{
+	va_list aq;
+	int len;
+
+	va_copy(aq, ap);
+	len = vsnprintf(line->buf + line->len, line->size - line->len, fmt, aq);
+	va_end(aq);
+
+	if (len < 0) {
+		line->buf[line->len] = '\0';
+		return;
+	}
+
+	if (line->len + len >= line->size) {
+		if (tap_line_reserve(line, len) != 0) {
+			line->buf[line->len] = '\0';
+			return;
+		}
+		vsnprintf(line->buf + line->len, line->size - line->len, fmt, ap);
+	}
+
+	line->len += len;
+}
+
+void tap_line_printf(tap_line_t *line, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	tap_line_vprintf(line, fmt, ap);
+	va_end(ap);
+}
+
+/* Output *******************************************************************/
+
+/** Write all iov entries, restarting on partial writes and EINTR */
+static void tap_output_writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t rtn;
+
+	while (iovcnt > 0) {
+		rtn = writev(fd, iov, iovcnt);
+		if (rtn < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+
+		tap_output_thread_written += rtn;
+		__atomic_add_fetch(&tap_output_written, rtn, __ATOMIC_RELAXED);
+
+		while (iovcnt > 0 && rtn >= iov->iov_len) {
+			rtn -= iov->iov_len;
+			iov++, iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base = (char*)iov->iov_base + rtn;
+			iov->iov_len -= rtn;
+		}
+	}
+}
+
+/** Write out the stdout buffer followed by buf (which may be NULL) */
+static void tap_output_drain(const char *buf, size_t len)
+{
+	struct iovec iov[2];
+	int iovcnt = 0;
+
+	if (tap_output_len) {
+		iov[iovcnt].iov_base = tap_output_buf;
+		iov[iovcnt++].iov_len = tap_output_len;
+	}
+
+	if (len) {
+		iov[iovcnt].iov_base = (char*)buf;
+		iov[iovcnt++].iov_len = len;
+	}
+
+	tap_output_len = 0;
+	tap_output_writev_all(STDOUT_FILENO, iov, iovcnt);
+}
+
+#ifdef HAVE_LIBPTHREAD
+/* Asynchronous output *****************************************************/
+
+/** Sleep until the producer stores a record behind tail */
+static void tap_ring_wait(size_t tail)
+{
+	int i;
+
+	for (i = 0; i < TAP_RING_SPIN; i++) {
+		if (__atomic_load_n(&tap_ring_head, __ATOMIC_ACQUIRE) != tail) {
+			return;
+		}
+		sched_yield();
+	}
+
+	pthread_mutex_lock(&tap_ring_lock);
+	__atomic_store_n(&tap_ring_waiting, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&tap_ring_head, __ATOMIC_SEQ_CST) == tail) {
+		pthread_cond_wait(&tap_ring_cond, &tap_ring_lock);
+	}
+	__atomic_store_n(&tap_ring_waiting, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&tap_ring_lock);
+}
+
+/** Writer thread, consecutive records for the same descriptor are written
+ *  by a single writev() */
+static void *tap_ring_thread(void *arg)
+{
+	struct iovec iov[TAP_RING_IOV];
+	struct tap_ring_rec_s *rec;
+	size_t head, pos, tail = 0;
+	int iovcnt, fd;
+
+	for (;;) {
+		tap_ring_wait(tail);
+		head = __atomic_load_n(&tap_ring_head, __ATOMIC_ACQUIRE);
+
+		for (pos = tail; pos != head; tail = pos) {
+			iovcnt = 0;
+			fd = -1;
+
+			while (pos != head && iovcnt < TAP_RING_IOV) {
+				rec = (void*)(tap_ring + 
+						(pos & (TAP_RING_SIZE - 1)));
+				if (rec->fd == TAP_RING_WRAP) {
+					pos += TAP_RING_SIZE - 
+						(pos & (TAP_RING_SIZE - 1));
+					continue;
+				}
+				if (iovcnt && rec->fd != fd) {
+					break;
+				}
+
+				fd = rec->fd;
+				iov[iovcnt].iov_base = rec + 1;
+				iov[iovcnt++].iov_len = rec->len;
+				pos += TAP_RING_ALIGN(sizeof *rec + rec->len);
+			}
+
+			if (iovcnt) {
+				tap_output_writev_all(fd, iov, iovcnt);
+			}
+
+			/* The space can be reused only after it was written */
+			__atomic_store_n(&tap_ring_tail, pos, __ATOMIC_RELEASE);
+		}
+	}
+
+	return NULL;
+}
+
+/** Wait until the writer thread writes everything what was queued */
+static void tap_ring_drain(void)
+{
+	/* Don't wait for ourselves, if a signal was delivered to the writer */
+	if (pthread_equal(pthread_self(), tap_ring_writer)) {
+		return;
+	}
+
+	while (__atomic_load_n(&tap_ring_tail, __ATOMIC_ACQUIRE) != 
+	       tap_ring_head) {
+		sched_yield();
+	}
+}
+
+/** Queue a line for the writer thread
+ *
+ * Lines are stored by one thread at a time, callers serialize the output.
+ * Lines too big for the ring are written directly, once it's empty.
+ */
+static void tap_ring_put(int fd, const struct iovec *iov, int iovcnt, 
+		size_t len)
+{
+	struct tap_ring_rec_s *rec;
+	struct iovec copy[iovcnt];
+	size_t need = TAP_RING_ALIGN(sizeof *rec + len);
+	size_t head = tap_ring_head;
+	size_t pad = 0;
+	char *data;
+	int i;
+
+	if (need > TAP_RING_SIZE / 2) {
+		tap_ring_drain();
+		memcpy(copy, iov, sizeof copy);
+		tap_output_writev_all(fd, copy, iovcnt);
+		return;
+	}
+
+	if ((head & (TAP_RING_SIZE - 1)) + need > TAP_RING_SIZE) {
+		pad = TAP_RING_SIZE - (head & (TAP_RING_SIZE - 1));
+	}
+
+	while (head + pad + need - 
+	       __atomic_load_n(&tap_ring_tail, __ATOMIC_ACQUIRE) > 
+	       TAP_RING_SIZE) {
+		sched_yield();
+	}
+
+	if (pad) {
+		rec = (void*)(tap_ring + (head & (TAP_RING_SIZE - 1)));
+		rec->fd = TAP_RING_WRAP;
+		head += pad;
+	}
+
+	rec = (void*)(tap_ring + (head & (TAP_RING_SIZE - 1)));
+	rec->fd = fd;
+	rec->len = len;
+	for (data = (char*)(rec + 1), i = 0; i < iovcnt; i++) {
+		memcpy(data, iov[i].iov_base, iov[i].iov_len);
+		data += iov[i].iov_len;
+	}
+
+	__atomic_store_n(&tap_ring_head, head + need, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&tap_ring_waiting, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&tap_ring_lock);
+		pthread_cond_signal(&tap_ring_cond);
+		pthread_mutex_unlock(&tap_ring_lock);
+	}
+}
+
+/** Start the writer thread, return 0 on success */
+static int tap_ring_start(void)
+{
+	if (pthread_create(&tap_ring_writer, NULL, tap_ring_thread, NULL)) {
+		return -1;
+	}
+
+	tap_output_async = 1;
+	return 0;
+}
+#endif // HAVE_LIBPTHREAD
+
+void tap_output_flush(void)
+{
+	int old_errno = errno;
+
+#ifdef HAVE_LIBPTHREAD
+	if (tap_output_async) {
+		tap_ring_drain();
+	}
+#endif
+	if (tap_output_len) {
+		tap_output_drain(NULL, 0);
+	}
+
+	errno = old_errno;
+}
+
+/** Write complete lines to stdout or stderr
+ *
+ * In the buffered mode stdout lines are collected in memory and written once
+ * the buffer is full. Anything going to stderr flushes stdout first, so the
+ * two streams are still interleaved correctly on a terminal.
+ */
+void tap_output_write(int fd, const char *buf, size_t len)
+{
+	struct iovec iov;
+	int old_errno = errno;
+
+#ifdef HAVE_LIBPTHREAD
+	if (tap_output_async) {
+		iov.iov_base = (char*)buf;
+		iov.iov_len = len;
+		tap_ring_put(fd, &iov, 1, len);
+	} else
+#endif
+	if (fd == STDOUT_FILENO && tap_output_buffered) {
+		if (tap_output_len + len <= sizeof tap_output_buf) {
+			memcpy(tap_output_buf + tap_output_len, buf, len);
+			tap_output_len += len;
+		} else {
+			tap_output_drain(buf, len);
+		}
+	} else {
+		tap_output_flush();
+		iov.iov_base = (char*)buf;
+		iov.iov_len = len;
+		tap_output_writev_all(fd, &iov, 1);
+	}
+
+	errno = old_errno;
+}
+
+/** Write a line composed from several pieces */
+void tap_output_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct iovec copy[iovcnt];
+	size_t len = 0;
+	int old_errno = errno;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	if (tap_output_async) {
+		tap_ring_put(fd, iov, iovcnt, len);
+	} else
+#endif
+	if (fd == STDOUT_FILENO && tap_output_buffered &&
+	    tap_output_len + len <= sizeof tap_output_buf) {
+		for (i = 0; i < iovcnt; i++) {
+			memcpy(tap_output_buf + tap_output_len, 
+					iov[i].iov_base, iov[i].iov_len);
+			tap_output_len += iov[i].iov_len;
+		}
+	} else {
+		tap_output_flush();
+		memcpy(copy, iov, sizeof copy);
+		tap_output_writev_all(fd, copy, iovcnt);
+	}
+
+	errno = old_errno;
+}
+
+/** Write the line out and reset it for the reuse */
+void tap_output_line(int fd, tap_line_t *line)
+{
+	tap_output_write(fd, line->buf, line->len);
+	line->len = 0;
+	line->buf[0] = '\0';
+}
+
+/** Flush the output and let the signal terminate us */
+static void tap_output_signal(int sig)
+{
+	tap_output_flush();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+/** Initialize the output
+ * @param mode - combination of TAP_OUTPUT_BUFFERED and TAP_OUTPUT_ASYNC
+ *
+ * Callers are responsible for serializing the output and flushing it at exit.
+ * On fatal signals the output is flushed here, unless the test installed its
+ * own handler for them. If the writer thread can't be started, the output
+ * is buffered instead.
+ */
+void tap_output_init(int mode)
+{
+
+#ifdef HAVE_LIBPTHREAD
+	if ((mode & TAP_OUTPUT_ASYNC) && tap_ring_start() == 0) {
+		mode &= ~TAP_OUTPUT_BUFFERED;
+	} else
+#endif
+	if (mode & TAP_OUTPUT_ASYNC) {
+		mode |= TAP_OUTPUT_BUFFERED;
+	}
+
+	tap_output_buffered = mode & TAP_OUTPUT_BUFFERED;
+	if (mode) {
+		tap_output_catch(tap_output_signal, 0);
+	}
+}
+
+/** Install handler of signals, which terminate the process
+ * @param handler - the handler, it should terminate the process
+ * @param force - replace also handlers installed by the test
+ */
+void tap_output_catch(void (*handler)(int), int force)
+{
+	struct sigaction sa, old;
+	int i;
+
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = handler;
+	sigemptyset(&sa.sa_mask);
+
+	for (i = 0; i < sizeof tap_output_signals/sizeof tap_output_signals[0]; i++) {
+		if (force || (0 == sigaction(tap_output_signals[i], NULL, &old) &&
+		    old.sa_handler == SIG_DFL)) {
+			sigaction(tap_output_signals[i], &sa, NULL);
+		}
+	}
+}
+
+/** Write the output synchronously in a forked child, which doesn't have
+ *  the writer thread. The output must be flushed before the fork. */
+void tap_output_fork_child(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	if (tap_output_async) {
+		tap_output_async = 0;
+		tap_output_buffered = 1;
+	}
+#endif
+}
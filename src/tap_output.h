@@ -0,0 +1,84 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_OUTPUT_H
+#define TAP_OUTPUT_H
+
+#include <sys/uio.h>
+#include <stdarg.h>
+#include <stddef.h>
+
+/** How many bytes of a line are kept on the stack before going to heap */
+#define TAP_LINE_LOCAL 256
+
+/** Output line being composed in memory */
+typedef struct tap_line_s {
+	char *buf;
+	size_t len;
+	size_t size;
+	char local[TAP_LINE_LOCAL];
+} tap_line_t;
+
+void tap_line_init(tap_line_t *line);
+
+void tap_line_free(tap_line_t *line);
+
+void tap_line_putc(tap_line_t *line, char c);
+
+void tap_line_write(tap_line_t *line, const char *str, size_t len);
+
+void tap_line_puts(tap_line_t *line, const char *str);
+
+void tap_line_printf(tap_line_t *line, const char *fmt, ...)
+		__attribute__ ((format (printf, 2, 3)));
+
+void tap_line_vprintf(tap_line_t *line, const char *fmt, va_list ap);
+
+/** Output modes for tap_output_init() */
+#define TAP_OUTPUT_BUFFERED 1
+#define TAP_OUTPUT_ASYNC    2
+
+void tap_output_init(int mode);
+
+void tap_output_fork_child(void);
+
+void tap_output_catch(void (*handler)(int), int force);
+
+void tap_output_write(int fd, const char *buf, size_t len);
+
+void tap_output_writev(int fd, const struct iovec *iov, int iovcnt);
+
+void tap_output_line(int fd, tap_line_t *line);
+
+void tap_output_flush(void);
+
+/** Bytes of the output written by the calling thread */
+extern __thread unsigned long long tap_output_thread_written;
+
+/** Bytes of the output written by the process */
+extern unsigned long long tap_output_written;
+
+#endif // TAP_OUTPUT_H
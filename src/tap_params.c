@@ -24,82 +24,176 @@
  * SUCH DAMAGE.
  */
 
-#include <sys/queue.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
 
 #include "tap_params.h"
 #include "tap_main.h"
+#include "tap_capture.h"
+#include "tap_heap.h"
+#include "tap_sched.h"
+#include "tap_perf.h"
+#include "tap_round.h"
+#include "tap_repeat.h"
+#include "tap_rusage.h"
 #include "tap.h"
 
-extern int tap_params_override_active;
-
 struct {
-	char *type; char *fmt; size_t size;
-} static numbers[] = {
-	{"unsigned int", "i", sizeof(unsigned int)},
-	{"int", "i", sizeof(int)},
-	{"unsigned long", "li", sizeof(unsigned long)},
-	{"long", "li", sizeof(long)},
-	{"unsigned long long", "lli", sizeof(unsigned long long)},
-	{"long long", "lli", sizeof(long long)},
-	{"char", "c", sizeof(char)},
+	int sig; const char *name;
+} static signals[] = {
+	{SIGHUP, "SIGHUP"}, {SIGINT, "SIGINT"}, {SIGQUIT, "SIGQUIT"},
+	{SIGILL, "SIGILL"}, {SIGTRAP, "SIGTRAP"}, {SIGABRT, "SIGABRT"},
+	{SIGBUS, "SIGBUS"}, {SIGFPE, "SIGFPE"}, {SIGKILL, "SIGKILL"},
+	{SIGSEGV, "SIGSEGV"}, {SIGPIPE, "SIGPIPE"}, {SIGALRM, "SIGALRM"},
+	{SIGTERM, "SIGTERM"}, {SIGXCPU, "SIGXCPU"}, {SIGXFSZ, "SIGXFSZ"},
 };
 
 
-TAILQ_HEAD(listhead, tap_param_s) tap_param_list;
+/** Descriptors of overridden parameters */
+static tap_param_desc_t **tap_param_overrides;
+static int tap_param_overrides_count;
 
-struct tap_param_s {
-	char *name;
-	char *type;
-	void *override;
-	int overriden;
-	TAILQ_ENTRY(tap_param_s) entries;
-};
+/** Bounds of the descriptors, see tap_params_init */
+static tap_param_desc_t *tap_params_first, *tap_params_last;
 
-static int tap_param_name_len = 0;
+#define TAP_PARAMS_BASIC(decl, type, tag) { decl, sizeof(type), \
+	__builtin_offsetof(struct { char c; type t; }, t), TAP_PARAM_ ## tag }
 
-static void add_entry(const char *name, const char *type, int array)
+/** Types of fields the struct body of TAP_PARAMS_DEFINITION is laid out of */
+static const struct {
+	const char *decl;
+	unsigned long size;
+	unsigned long align;
+	enum tap_param_type_e type;
+} tap_params_basic[] = {
+	TAP_PARAMS_BASIC("char", char, CHAR),
+	TAP_PARAMS_BASIC("signed char", signed char, SIGNED),
+	TAP_PARAMS_BASIC("unsigned char", unsigned char, UNSIGNED),
+	TAP_PARAMS_BASIC("short", short, SIGNED),
+	TAP_PARAMS_BASIC("short int", short, SIGNED),
+	TAP_PARAMS_BASIC("signed short", short, SIGNED),
+	TAP_PARAMS_BASIC("unsigned short", unsigned short, UNSIGNED),
+	TAP_PARAMS_BASIC("unsigned short int", unsigned short, UNSIGNED),
+	TAP_PARAMS_BASIC("int", int, SIGNED),
+	TAP_PARAMS_BASIC("signed", int, SIGNED),
+	TAP_PARAMS_BASIC("signed int", int, SIGNED),
+	TAP_PARAMS_BASIC("unsigned", unsigned, UNSIGNED),
+	TAP_PARAMS_BASIC("unsigned int", unsigned, UNSIGNED),
+	TAP_PARAMS_BASIC("long", long, SIGNED),
+	TAP_PARAMS_BASIC("long int", long, SIGNED),
+	TAP_PARAMS_BASIC("signed long", long, SIGNED),
+	TAP_PARAMS_BASIC("unsigned long", unsigned long, UNSIGNED),
+	TAP_PARAMS_BASIC("unsigned long int", unsigned long, UNSIGNED),
+	TAP_PARAMS_BASIC("long long", long long, SIGNED),
+	TAP_PARAMS_BASIC("long long int", long long, SIGNED),
+	TAP_PARAMS_BASIC("signed long long", long long, SIGNED),
+	TAP_PARAMS_BASIC("unsigned long long", unsigned long long, UNSIGNED),
+	TAP_PARAMS_BASIC("unsigned long long int", unsigned long long, UNSIGNED),
+	TAP_PARAMS_BASIC("float", float, OTHER),
+	TAP_PARAMS_BASIC("double", double, OTHER),
+	TAP_PARAMS_BASIC("long double", long double, OTHER),
+	TAP_PARAMS_BASIC("enum", int, OTHER),
+	TAP_PARAMS_BASIC("char *", char *, STRING),
+	TAP_PARAMS_BASIC("*", void *, OTHER),
+};
+
+/** Lay out the field declared by decl (without its name and dimensions)
+ * @return 0 or -1 if the type isn't known
+ */
+static int tap_params_layout(tap_param_desc_t *desc, const char *decl, 
+		unsigned long nmemb, unsigned long *end, unsigned long *align)
 {
-	struct tap_param_s *new;
+	char type[64];
+	const char *word;
+	int i, pos = 0, len, pointer = 0;
 
-	if (0 == strcmp(name, "_tap_skip")) {
-		return;
-	}
+	type[0] = '\0';
 
-	if (tap_param_name_len < strlen(name)) {
-		tap_param_name_len = strlen(name);
+	// Keep words of the type without qualifiers and the name of enum
+	for (word = decl; *word; word += len) {
+		len = strcspn(word, " *");
+		if (len == 0) {
+			pointer += *word == '*';
+			len = 1;
+		} else if ((len != 5 || strncmp(word, "const", 5)) && 
+				(len != 8 || strncmp(word, "volatile", 8)) && 
+				(pos < 4 || strncmp(type, "enum", 4)) && 
+				pos + len + 3 < sizeof type) {
+			pos += sprintf(type + pos, pos ? " %.*s" : "%.*s", 
+					len, word);
+		}
+	}
+	if (pointer) {
+		pos = pointer == 1 && !strcmp(type, "char") ? pos : 0;
+		strcpy(type + pos, pos ? " *" : "*");
 	}
-       
-	new = malloc(sizeof *new + strlen(name) + strlen(type) + 8 + 2 + 1 + 1);
-
-	new->override = (char*)new + sizeof *new;
-	new->name = (char*)new->override + 8;
-	new->type = new->name + strlen(name) + 1;
-	new->overriden = 0;
 
-	strcpy(new->name, name);
-	strcpy(new->type, type);
+	for (i = 0; i < sizeof tap_params_basic / sizeof *tap_params_basic; i++) {
+		if (0 == strcmp(tap_params_basic[i].decl, type)) {
+			break;
+		}
+	}
+	if (i == sizeof tap_params_basic / sizeof *tap_params_basic) {
+		return -1;
+	}
 
-	if (array) {
-		strcat(new->type, "[]");
+	desc->size = tap_params_basic[i].size * nmemb;
+	desc->type = nmemb == 1 ? tap_params_basic[i].type : TAP_PARAM_OTHER;
+	desc->offset = (*end + tap_params_basic[i].align - 1) & 
+			~(tap_params_basic[i].align - 1);
+	*end = desc->offset + desc->size;
+	if (*align < tap_params_basic[i].align) {
+		*align = tap_params_basic[i].align;
 	}
 
-	TAILQ_INSERT_TAIL(&tap_param_list, new, entries);
+	return 0;
 }
 
+/** Find descriptors of the parameters
+ * @param params_def - Struct body of the legacy TAP_PARAMS_DEFINITION or ""
+ *
+ * The struct body is parsed into the descriptors, if it contains a type
+ * which isn't known or if it doesn't result in tap_params_size, none of 
+ * the parameters can be overridden.
+ */
 void tap_params_init(const char *params_def)
 {
-	char *parsed = malloc(strlen(params_def) + 1);
-	char *parsed_ptr, *token_ptr, *token;
-	int i, nested, pos, in_space;
+	char *parsed, *parsed_ptr, *token, *name, *dims;
+	unsigned long nmemb, end, align;
+	tap_param_desc_t *desc;
+	int i, nested, pos, in_space, known = 1;
+
+	if (params_def[0] == '\0') {
+		tap_params_first = tap_params_desc[0];
+		tap_params_last = tap_params_desc[1];
+		return;
+	}
 
-	TAILQ_INIT(&tap_param_list);
+	parsed = malloc(strlen(params_def) + 1);
+	tap_params_first = malloc(strlen(params_def) * sizeof *desc);
+	if (parsed == NULL || tap_params_first == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(255);
+	}
+	tap_params_last = tap_params_first;
 
-	// Remove nested
+	// Remove nested definitions and duplicate spaces
 	i = 0, nested = 0, pos = 0, in_space = 1;
 	do {
 		switch (params_def[i]) {
@@ -108,6 +202,7 @@ void tap_params_init(const char *params_def)
 				break;
 			case '}':
 				nested--;
+				/* fall through */
 			case ' ':
 			case '\t':
 			case '\n':
@@ -118,373 +213,2268 @@ void tap_params_init(const char *params_def)
 				break;
 			default:
 				if (nested == 0) {
-					if (params_def[i] == ';') {
-						if (in_space) {
-							pos--;
-						}
-						in_space = 1;
-					} else {
-						in_space = 0;
+					if (params_def[i] == ';' && in_space && 
+							pos > 0) {
+						pos--;
 					}
+					in_space = params_def[i] == ';';
 					parsed[pos++] = params_def[i];
 				}
 		}
 	} while (params_def[i++] != 0);
 
+	end = sizeof(tap_params_header_t);
+	align = __alignof__(tap_params_header_t);
 	parsed_ptr = parsed;
 	while (NULL != (token = strsep(&parsed_ptr, ";"))) {
-		char *tmp;
+		if (*token == '\0') {
+			continue;
+		}
 
-		if (*token == 0) continue;
-		
-		token_ptr = rindex(token, '[');
-		if (token_ptr) {
-			if (token_ptr[-1] == ' ') token_ptr--;
-			*token_ptr = '\0';
+		// Dimensions of an array
+		nmemb = 1;
+		dims = index(token, '[');
+		if (dims) {
+			for (name = dims; name > token && name[-1] == ' '; 
+					name--);
+			*name = '\0';
+			dims++;
+			while (dims) {
+				nmemb *= strtoul(dims, &dims, 0);
+				if (*dims != ']') {
+					known = 0;
+					break;
+				}
+				dims = index(dims, '[');
+			}
+		}
+
+		// The name is the last word
+		for (name = token + strlen(token); name > token && 
+				(isalnum(name[-1]) || name[-1] == '_'); name--);
+		if (*name == '\0' || strpbrk(token, ",:(")) {
+			known = 0;
+			continue;
+		}
+
+		desc = tap_params_last++;
+		memset(desc, 0, sizeof *desc);
+		desc->name = strdup(name);
+		while (name > token && name[-1] == ' ') {
+			name--;
+		}
+		*name = '\0';
+		desc->decl = malloc(strlen(token) + 3);
+		if (desc->decl) {
+			sprintf((char*)desc->decl, "%s%s", token, 
+					dims ? "[]" : "");
 		}
+		if (desc->name == NULL || desc->decl == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(255);
+		}
+
+		if (known && tap_params_layout(desc, token, nmemb, &end, 
+					&align)) {
+			known = 0;
+		}
+	}
+	free(parsed);
 
-		tmp = rindex(token, ' ');
-		for (*tmp++ = '\0'; tmp[0] == '*'; tmp++) {
-			tmp[-1] = '*';
-			tmp[0] = '\0';
+	if (!known || ((end + align - 1) & ~(align - 1)) != tap_params_size) {
+		for (desc = tap_params_first; desc < tap_params_last; desc++) {
+			desc->type = TAP_PARAM_OTHER;
 		}
-		add_entry(tmp, token, token_ptr != NULL);
 	}
 }
 
-void *tap_get_override(const char *name, void *fallback)
+static tap_param_desc_t *tap_param_desc_find(const char *name)
 {
-	struct tap_param_s *param;
+	tap_param_desc_t *desc;
 
-	TAILQ_FOREACH(param, &tap_param_list, entries) {
-		if (0 == strcmp(param->name, name)) {
-			return param->overriden ? param->override : fallback;
+	for (desc = tap_params_first; desc < tap_params_last; desc++) {
+		if (0 == strcmp(desc->name, name)) {
+			return desc;
 		}
 	}
+
+	return NULL;
+}
+
+/** Parse value of the parameter described by desc into dest
+ * @return NULL or the error message, with %s for the value
+ *
+ * A string is stored as the value pointer, it must live as long as dest.
+ */
+static const char *tap_param_parse(const tap_param_desc_t *desc, 
+		const char *value, void *dest)
+{
+	unsigned long long number;
+	char *end;
+
+	errno = 0;
+	switch (desc->type) {
+		case TAP_PARAM_STRING:
+			*(const char**)dest = value;
+			break;
+		case TAP_PARAM_CHAR:
+			if (value[0] == '\0' || value[1] != '\0') {
+				return "'%s' is not a valid character";
+			}
+			*(char*)dest = value[0];
+			break;
+		case TAP_PARAM_SIGNED:
+		case TAP_PARAM_UNSIGNED:
+			if (desc->type == TAP_PARAM_SIGNED) {
+				number = strtoll(value, &end, 0);
+			} else {
+				number = strtoull(value, &end, 0);
+			}
+			if (*value == '\0' || *end != '\0' || errno) {
+				return "'%s' is not a valid number";
+			}
+			switch (desc->size) {
+				case 1: *(unsigned char*)dest = number; break;
+				case 2: *(unsigned short*)dest = number; break;
+				case 4: *(unsigned int*)dest = number; break;
+				case 8: *(unsigned long long*)dest = number; break;
+			}
+			break;
+		default:
+			return "'%s' can't be assigned to a parameter of this type";
+	}
+
+	return NULL;
 }
 
 void tap_param_override(const char *name, const char *value)
 {
-	struct tap_param_s *param;
-	int i;
-	char buf[10];
+	tap_param_desc_t *found;
+	const char *error;
+	void *override;
 
-	TAILQ_FOREACH(param, &tap_param_list, entries) {
-		if (0 == strcmp(name, param->name)) {
-			for (i = 0; i < sizeof numbers/sizeof numbers[0]; i++) {
-				if (0 == strcmp(param->type, numbers[i].type)) {
-					char none;
+	found = tap_param_desc_find(name);
+	if (found == NULL) {
+		fprintf(stderr, "Parameter '%s' does not exist\n", name);
+		exit(255);
+	}
 
-					strcpy(buf, "%");
-					strcat(buf, numbers[i].fmt);
-					strcat(buf, "%c");
+	if (found->type == TAP_PARAM_OTHER) {
+		fprintf(stderr, "Parameter '%s' can't be overridden\n", 
+				name);
+		exit(255);
+	}
 
-					if (1 != sscanf(value, buf, param->override, &none)) {
-						fprintf(stderr, "'%s' is not a valid number\n", value);
-						exit(255);
-					}
+	override = malloc(sizeof(unsigned long long));
+	if (found->type == TAP_PARAM_STRING) {
+		value = strdup(value);
+	}
+	if (!override || !value) {
+		fprintf(stderr, "Out of memory\n");
+		exit(255);
+	}
 
-					param->overriden = 1;
+	error = tap_param_parse(found, value, override);
+	if (error) {
+		fprintf(stderr, error, value);
+		fputc('\n', stderr);
+		exit(255);
+	}
 
-					return;
-				}
-			}
-			if (0 == strcmp(param->type, "const char*") ||
-			    0 == strcmp(param->type, "const char *") ||
-			    0 == strcmp(param->type, "char*") ||
-			    0 == strcmp(param->type, "char *")) {
-				*(char**)param->override = malloc(strlen(value) + 1);
-				strcpy(*(char**)param->override, value);
-				param->overriden = 1;
-				return;
+	if (found->override == NULL) {
+		tap_param_overrides = realloc(tap_param_overrides, 
+				(tap_param_overrides_count + 1) * sizeof found);
+		tap_param_overrides[tap_param_overrides_count++] = found;
+	}
+	free(found->override);
+	found->override = override;
+}
+
+/** Rounds, elements of the values array or points of the matrix */
+static struct {
+	/** Values array or values shared by rounds of the matrix */
+	void *vals;
+	unsigned long size;
+	unsigned long nmemb;
+	/** Axes of the matrix in order of declaration, NULL for the array */
+	tap_params_axis_t **axes;
+	int naxes;
+	/** Bitset of skipped rounds, see TAP_PARAMS_SKIPPED */
+	unsigned long *skip;
+} tap_rounds;
+
+static int tap_params_axis_cmp(const void *a, const void *b)
+{
+	return (*(tap_params_axis_t**)a)->line - (*(tap_params_axis_t**)b)->line;
+}
+
+static void tap_params_skip_set(unsigned long i, int skip)
+{
+	unsigned long bit = 1UL << i % TAP_PARAMS_SKIP_BITS;
+
+	if (skip) {
+		tap_rounds.skip[i / TAP_PARAMS_SKIP_BITS] |= bit;
+	} else {
+		tap_rounds.skip[i / TAP_PARAMS_SKIP_BITS] &= ~bit;
+	}
+}
+
+void tap_params_rounds(void *vals, unsigned long vals_size, 
+		unsigned long vals_nmemb)
+{
+	tap_params_axis_t *axis;
+	unsigned long i;
+
+	tap_rounds.vals = vals;
+	tap_rounds.size = vals_size;
+	tap_rounds.nmemb = vals_nmemb;
+
+	if (tap_params_axes[0] < tap_params_axes[1]) {
+		tap_rounds.naxes = tap_params_axes[1] - tap_params_axes[0];
+		tap_rounds.axes = malloc(tap_rounds.naxes * 
+				sizeof *tap_rounds.axes);
+		if (tap_rounds.axes == NULL) {
+			BAIL_OUT("Out of memory");
+		}
+
+		tap_rounds.nmemb = 1;
+		for (i = 0; i < tap_rounds.naxes; i++) {
+			axis = tap_params_axes[0] + i;
+			if (axis->nmemb && 
+			    tap_rounds.nmemb > ULONG_MAX / axis->nmemb) {
+				fprintf(stderr, "The matrix of parameters has "
+						"too many rounds\n");
+				exit(255);
 			}
+			tap_rounds.nmemb *= axis->nmemb;
+			tap_rounds.axes[i] = axis;
 		}
+
+		qsort(tap_rounds.axes, tap_rounds.naxes, 
+				sizeof *tap_rounds.axes, tap_params_axis_cmp);
+	}
+
+	tap_rounds.skip = calloc(tap_rounds.nmemb / TAP_PARAMS_SKIP_BITS + 1, 
+			sizeof *tap_rounds.skip);
+	if (tap_rounds.skip == NULL) {
+		BAIL_OUT("Out of memory");
 	}
 
-	fprintf(stderr, "Parameter '%s' does not exist\n", name);
-	exit(255);
+	if (tap_rounds.axes) {
+		if (((tap_params_header_t*)vals)->skip) {
+			memset(tap_rounds.skip, 0xff, (tap_rounds.nmemb / 
+					TAP_PARAMS_SKIP_BITS + 1) * 
+					sizeof *tap_rounds.skip);
+		}
+	} else for (i = 0; i < vals_nmemb; i++) {
+		tap_params_skip_set(i, ((tap_params_header_t*)
+				((char*)vals + i * vals_size))->skip);
+	}
 }
 
-static void tc_skip_string(const char **string)
+/** Rounds read from a data file, see tap_params_data */
+static struct {
+	const char *file;
+	const char *map;
+	size_t size;
+	/** Parameters of columns */
+	const tap_param_desc_t **columns;
+	char **names;
+	int ncolumns;
+	/** True, if the plan of rounds is a column */
+	int plan;
+	/** First round, its line number and the round at the cursor */
+	const char *first;
+	unsigned long first_lineno;
+	unsigned long round;
+	const char *line;
+	unsigned long lineno;
+	/** Values of the round at the cursor, strings point here */
+	char *strings;
+	size_t strings_size;
+	/** Pages before this were dropped */
+	const char *released;
+} tap_data;
+
+/** Drop mapped pages before pos, so the memory doesn't grow with the file */
+static void tap_data_release(const char *pos)
 {
-	int escape = 0;
+	long page = sysconf(_SC_PAGESIZE);
+	const char *end;
 
-	while (*++(*string)) switch (**string) {
-		case '\\':
-			escape = 1;
-			break;
-		case '"':
-			if (escape == 0) {
-				return;
-			}
-		default:
-			escape = 0;
+	end = tap_data.map + (pos - tap_data.map) / page * page;
+	if (end - tap_data.released >= 256 * page) {
+		madvise((void*)tap_data.released, end - tap_data.released, 
+				MADV_DONTNEED);
+		tap_data.released = end;
 	}
 }
 
-static void tap_dump_def_indent(int level)
+/** Column with the number of tests planned for the round */
+static const tap_param_desc_t tap_data_plan = {
+	"tap.plan", "int", __builtin_offsetof(tap_params_header_t, plan), 
+	sizeof(int), TAP_PARAM_SIGNED
+};
+
+/** End of the line starting at pos, a carriage return isn't included */
+static const char *tap_data_eol(const char *pos)
 {
-	level = level * 4 + 2;
-	while (level-- > 0) {
-		putchar(' ');
+	const char *eol;
+
+	eol = memchr(pos, '\n', tap_data.map + tap_data.size - pos);
+	if (eol == NULL) {
+		eol = tap_data.map + tap_data.size;
+	}
+	if (eol > pos && eol[-1] == '\r') {
+		eol--;
 	}
+
+	return eol;
 }
 
-static void tap_params_dump_val(const char *name, const char *val,
-		const char **val_str, int *val_len)
+/** Skip empty and comment lines starting at pos, NULL at the end */
+static const char *tap_data_skip(const char *pos, unsigned long *lineno)
 {
-	char *start;
-	int found = 0;
-	int nested = 0;
+	const char *c;
 
-	while (*++val) switch (*val) {
-		case ')':
-			goto end;
-		case '.':
-			if (  0 == nested &&
-			      0 == strncmp(name, val + 1, strlen(name)) &&
-			      0 == isalnum(val[1 + strlen(name)]) &&
-			    '_' != val[1 + strlen(name)]) {
-				found = 1;
-				start = index(val + 1 + strlen(name), '=') + 1;
-				while (isblank(*start)) start++;
-				val = start - 1;
-			}
-			break;
-		case '"':
-			tc_skip_string(&val);
-			break;
-		case '{':
-			nested++;
-			break;
-		case '}':
-			nested--;
-			break;
-		case ',':
-			if (nested == 0 && found) goto end;
+	while (pos < tap_data.map + tap_data.size) {
+		for (c = pos; c < tap_data.map + tap_data.size && 
+				(*c == ' ' || *c == '\t' || *c == '\r'); c++);
+		if (c < tap_data.map + tap_data.size && *c != '\n' && 
+		    *c != '#') {
+			return pos;
+		}
+		pos = memchr(c, '\n', tap_data.map + tap_data.size - c);
+		if (pos == NULL) {
 			break;
+		}
+		pos++;
+		(*lineno)++;
 	}
 
-end:
-	if (found) {
-		*val_str = start;
-		*val_len = val - start;
-	} else {
-		*val_str = "0";
-		*val_len = 1;
-	}
+	return NULL;
 }
 
+/** Next round after the line starting at pos */
+static const char *tap_data_next(const char *pos, unsigned long *lineno)
+{
+	pos = memchr(pos, '\n', tap_data.map + tap_data.size - pos);
+	if (pos == NULL) {
+		return NULL;
+	}
+
+	(*lineno)++;
+	return tap_data_skip(pos + 1, lineno);
+}
 
-static void tap_dump_def(char **definition, int level)
+/** Parse a value of CSV at pos into out, out must have eol - pos + 1 bytes
+ * @param raw - the value as it is written
+ * @return 1, if another value follows
+ */
+static int tap_data_cell(const char **pos, const char *eol, char *out, 
+		const char **raw, int *raw_len)
 {
-	int in_space = 1;
-	int in_nl = 1;
+	const char *c = *pos;
+	char *start = out;
 
-	while (*++(*definition)) switch (**definition) {
-		case '{':
-			if (in_space) {
-				printf("{\n");
+	while (c < eol && (*c == ' ' || *c == '\t')) c++;
+	*raw = c;
+
+	if (c < eol && *c == '"') {
+		for (c++; c < eol; c++) {
+			if (*c == '"' && c + 1 < eol && c[1] == '"') {
+				*out++ = *c++;
+			} else if (*c == '"') {
+				c++;
+				break;
 			} else {
-				printf(" {\n");
-			}
-			//++*definition;
-			tap_dump_def(definition, level + 1);
-			in_space = 1;
-			break;
-		case '}':
-			if (in_nl == 0) {
-				putchar('\n');
-			}
-			tap_dump_def_indent(level - 1);
-			printf("} ");
-			return;
-		case ';':
-			printf(";\n");
-			in_nl = 1;
-			in_space = 1;
-			break;
-		case ' ':
-		case '\n':
-		case '\t':
-			if (in_space == 0) {
-				putchar(' ');
+				*out++ = *c;
 			}
-			in_space = 1;
-			break;
-		default:
-			if (in_nl) {
-				tap_dump_def_indent(level);
-				in_nl = 0;
-			}
-			in_space = 0;
-			putchar(**definition);
+		}
+		*raw_len = c - *raw;
+		while (c < eol && *c != ',') c++;
+	} else {
+		while (c < eol && *c != ',') *out++ = *c++;
+		while (out > start && (out[-1] == ' ' || out[-1] == '\t')) {
+			out--;
+		}
+		*raw_len = out - start;
 	}
+	*out = '\0';
+
+	*pos = c + 1;
+	return c < eol;
 }
 
-static void tap_verbose_print(const char *fmt, ...)
+/** Parameter set by the column of the data file */
+static const tap_param_desc_t *tap_data_column(const char *name)
 {
-	va_list ap;
+	const tap_param_desc_t *desc;
 
-	if (tap_verbose == 0) return;
+	if (0 == strcmp(name, tap_data_plan.name)) {
+		tap_data.plan = 1;
+		return &tap_data_plan;
+	}
 
-	fputs("# ", stderr);
-	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
-	va_end(ap);
+	desc = tap_param_desc_find(name);
+	if (desc == NULL) {
+		fprintf(stderr, "Column '%s' of '%s' isn't a parameter\n", 
+				name, tap_data.file);
+		exit(1);
+	}
+	if (desc->type == TAP_PARAM_OTHER) {
+		fprintf(stderr, "Parameter '%s' can't be read from '%s'\n", 
+				name, tap_data.file);
+		exit(1);
+	}
 
-	fputs("\n", stderr);
+	return desc;
 }
 
-static void tap_params_dump_vals(const char *vals_def, 
-		int num)
+/** Execute rounds read from a file instead of the values array
+ *
+ * The file is CSV, the first line names parameters of columns and every
+ * following line is one round. Values not in the file are taken from the
+ * first element of the values array. Column 'tap.plan' sets the number
+ * of tests planned for the round. Empty lines and lines starting with '#'
+ * are ignored. The file is mapped and rounds are parsed when they are
+ * executed, only the number of rounds is counted in advance.
+ */
+void tap_params_data(const char *file)
 {
-	struct tap_param_s *param;
-	const char *start;
-	const char *val;
-	char buf[64], *end;
-	int val_len;
-	int i;
-	
-	start = vals_def; num++;
-	while (num--) {
-		start = strstr(start, "TAP_PARAMS_VALUES");
-		if (start == NULL) {
-			start = "TAP_PARAMS_VALUES ()";
-			break;
+	const char *pos, *eol, *raw;
+	struct stat st;
+	int fd, more, len;
+
+	if (tap_rounds.axes) {
+		fprintf(stderr, "Option -d can't be used with parameters "
+				"defined by TAP_PARAMS_MATRIX\n");
+		exit(1);
+	}
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		fprintf(stderr, "Can't open '%s': %s\n", file, strerror(errno));
+		exit(1);
+	}
+
+	tap_data.file = file;
+	tap_data.size = st.st_size;
+	if (tap_data.size) {
+		tap_data.map = mmap(NULL, tap_data.size, PROT_READ, MAP_PRIVATE,
+				fd, 0);
+		if (tap_data.map == MAP_FAILED) {
+			fprintf(stderr, "Can't map '%s': %s\n", file, 
+					strerror(errno));
+			exit(1);
 		}
-		start++;
+		madvise((void*)tap_data.map, tap_data.size, MADV_SEQUENTIAL);
 	}
+	close(fd);
 
-	// Dump
-	start = index(start, '(') + 1;
-	TAILQ_FOREACH(param, &tap_param_list, entries) {
-		tap_params_dump_val(param->name, start, &val, &val_len);
-
-		if (tap_params_override_active && param->overriden) {
-			for (i = 0; i < sizeof numbers/sizeof numbers[0]; i++) {
-				if (0 == strcmp(param->type, numbers[i].type)) {
-					switch (numbers[i].size) {
-						case 8:
-							sprintf(buf, "0x%llX (default: ", *(long long*)param->override);
-							break;
-						case 4:
-							sprintf(buf, "0x%X (default: ", *(int*)param->override);
-							break;
-						case 2:
-							sprintf(buf, "0x%X (default: ", *(short*)param->override);
-							break;
-						case 1:
-							sprintf(buf, "0x%X (default: ", *(char*)param->override);
-							break;
-					}
-					break;
-				}
-			}
-			if (0 == strcmp(param->type, "const char*") ||
-			    0 == strcmp(param->type, "const char *") ||
-			    0 == strcmp(param->type, "char*") ||
-			    0 == strcmp(param->type, "char *")) {
-				snprintf(buf, sizeof buf, "\"%s\" (default: ", *(char**)param->override);
-			}
-			end = ")";
-		} else {
-			buf[0] = 0;
-			end = "";
-		}	
+	tap_data.lineno = 1;
+	pos = tap_data.size ? tap_data_skip(tap_data.map, &tap_data.lineno) : NULL;
+	if (pos == NULL) {
+		fprintf(stderr, "'%s' doesn't name parameters on the first "
+				"line\n", file);
+		exit(1);
+	}
+
+	eol = tap_data_eol(pos);
+	do {
+		tap_data.ncolumns++;
+		tap_data.columns = realloc(tap_data.columns, tap_data.ncolumns *
+				sizeof *tap_data.columns);
+		tap_data.names = realloc(tap_data.names, tap_data.ncolumns * 
+				sizeof *tap_data.names);
+		if (!tap_data.columns || !tap_data.names || NULL == 
+				(tap_data.names[tap_data.ncolumns - 1] = 
+				 malloc(eol - pos + 1))) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+
+		more = tap_data_cell(&pos, eol, 
+				tap_data.names[tap_data.ncolumns - 1], &raw, &len);
+		tap_data.columns[tap_data.ncolumns - 1] = tap_data_column(
+				tap_data.names[tap_data.ncolumns - 1]);
+	} while (more);
+
+	tap_data.first_lineno = tap_data.lineno;
+	tap_data.first = tap_data_next(eol, &tap_data.first_lineno);
+
+	// Count rounds
+	tap_rounds.nmemb = 0;
+	tap_data.lineno = tap_data.first_lineno;
+	tap_data.released = tap_data.map;
+	for (pos = tap_data.first; pos; pos = tap_data_next(pos, 
+				&tap_data.lineno)) {
+		tap_rounds.nmemb++;
+		tap_data_release(pos);
+	}
+	tap_data_release(tap_data.map + tap_data.size);
+	tap_data.released = tap_data.map;
+
+	tap_data.line = tap_data.first;
+	tap_data.lineno = tap_data.first_lineno;
+	tap_data.round = 0;
 
-		tap_verbose_print("% *s: %s%.*s%s", tap_param_name_len, 
-				param->name, buf, val_len, val, end);
+	free(tap_rounds.skip);
+	tap_rounds.skip = calloc(tap_rounds.nmemb / TAP_PARAMS_SKIP_BITS + 1, 
+			sizeof *tap_rounds.skip);
+	if (tap_rounds.skip == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	if (((tap_params_header_t*)tap_rounds.vals)->skip) {
+		memset(tap_rounds.skip, 0xff, (tap_rounds.nmemb / 
+				TAP_PARAMS_SKIP_BITS + 1) * sizeof *tap_rounds.skip);
 	}
 }
 
-int tap_param_skip(char *range, void *vals, unsigned long vals_size, 
-		unsigned long vals_nmemb)
+/** Move the cursor to round i */
+static void tap_data_seek(unsigned long i)
 {
-	char *token;
-	int start, end, tmp, i;
-	static int disabled = 0;
+	if (i < tap_data.round) {
+		tap_data.released = tap_data.map;
+		tap_data.round = 0;
+		tap_data.line = tap_data.first;
+		tap_data.lineno = tap_data.first_lineno;
+	}
 
-	if (disabled == 0) {
-		disabled = 1;
-		for (i = 0; i < vals_nmemb; i++) {
-			*(int*)((char*)vals + i * vals_size) = 1;
-		}
+	for (; tap_data.round < i; tap_data.round++) {
+		tap_data.line = tap_data_next(tap_data.line, &tap_data.lineno);
 	}
+	tap_data_release(tap_data.line);
+}
 
-	while (NULL != (token = strsep(&range, ","))) {
-		if (*token == 0) continue;
-		
-		if (index(token, '-')) {
-			if (2 != sscanf(token, "%d-%d%c", &start, &end, &tmp)) {
-				start = -1;
-			} else if (end < start) {
-				start = -1;
-			}
-		} else {
-			if (1 != sscanf(token, "%d%c", &start, &tmp)) {
-				start = -1;
-			} else {
-				end = start;
-			}
-		}
+/** Split values of round i into tap_data.strings
+ * @param field - called with every value, the raw value and its length
+ */
+static void tap_data_split(unsigned long i, void (*field)(int column, 
+			const char *value, const char *raw, int raw_len, 
+			void *arg), void *arg)
+{
+	const char *pos, *eol, *raw;
+	char *out;
+	int n, more = 1, len;
 
-		if (start < 0) {
-			return -1;
-		}
+	tap_data_seek(i);
 
-		for (i = start; i < vals_nmemb && i <= end; i++) {
-			*(int*)((char*)vals + i * vals_size) = 0;
+	pos = tap_data.line;
+	eol = tap_data_eol(pos);
+	if (tap_data.strings_size < eol - pos + 1) {
+		tap_data.strings_size = 2 * (eol - pos + 1);
+		free(tap_data.strings);
+		tap_data.strings = malloc(tap_data.strings_size);
+		if (tap_data.strings == NULL) {
+			BAIL_OUT("Out of memory");
 		}
 	}
 
-	return 0;
+	/* Every value is shorter than its text with the separator */
+	out = tap_data.strings;
+	for (n = 0; n < tap_data.ncolumns && more; n++) {
+		more = tap_data_cell(&pos, eol, out, &raw, &len);
+		field(n, out, raw, len, arg);
+		out += strlen(out) + 1;
+	}
+
+	if (n < tap_data.ncolumns || more) {
+		BAIL_OUT("%s:%lu: Expected %d values", tap_data.file, 
+				tap_data.lineno, tap_data.ncolumns);
+	}
 }
 
-void tap_params_main(char *params_def, char *vals_def, 
-		void *vals, void **current, 
-		unsigned long vals_size, unsigned long vals_nmemb, 
-		int count)
+static void tap_data_parse(int column, const char *value, const char *raw,
+		int raw_len, void *buf)
 {
-	int i, j;
-	int tc_count = 0;
+	const tap_param_desc_t *desc = tap_data.columns[column];
+	const char *error;
+	char msg[128];
 
-	for (i = 0; i < vals_nmemb; i++) {
-		tap_params_header_t *hdr = 
-				(tap_params_header_t *)((char*)vals + i * vals_size);
-		if (hdr->skip == 0) {
-			tc_count += hdr->plan;
-		}
+	error = tap_param_parse(desc, value, (char*)buf + desc->offset);
+	if (error) {
+		snprintf(msg, sizeof msg, error, value);
+		BAIL_OUT("%s:%lu: %s", tap_data.file, tap_data.lineno, msg);
 	}
-	
-	tap_init(tap_flags);
+}
 
-	plan_tests(tc_count * count);
+/** Get values of round i, a round of the matrix or of the data file is
+ *  built in buf */
+static void *tap_params_round(unsigned long i, void *buf)
+{
+	tap_params_axis_t *axis;
+	int n;
 
-	for (i = 0; i < vals_nmemb; i++) {
-		*current = (char*)vals + i * vals_size;
+	if (tap_data.file) {
+		memcpy(buf, tap_rounds.vals, tap_rounds.size);
+		tap_data_split(i, tap_data_parse, buf);
+		return buf;
+	}
 
-		if (((tap_params_header_t*)*current)->skip) {
-			tap_verbose_print("Skipping round %d", i);
-			continue;
-		} else {
-			tap_verbose_print("Starting round %d", i);
-			tap_params_dump_vals(vals_def, i);
-		}
+	if (tap_rounds.axes == NULL) {
+		return (char*)tap_rounds.vals + i * tap_rounds.size;
+	}
 
-		for (j = 0; j < count; j++) {
-			tap_main(i);
-		}
+	memcpy(buf, tap_rounds.vals, tap_rounds.size);
+	for (n = tap_rounds.naxes - 1; n >= 0; n--) {
+		axis = tap_rounds.axes[n];
+		memcpy((char*)buf + axis->offset, (const char*)axis->vals + 
+				i % axis->nmemb * axis->size, axis->size);
+		i /= axis->nmemb;
 	}
+
+	return buf;
 }
 
-void tap_params_info(void)
+/** Make round i current, overrides are applied to the private copy
+ * @param copy - buffer of the size of one round
+ */
+static void tap_params_enter(unsigned long i, void *copy)
 {
-	if (0 == strlen(tap_params_def)) {
-		printf("This test case does not have any parameters defined.\n");
-	} else {
-		char *params_def = (char*)tap_params_def - 1;
-		printf("Parameters:\n");
-		tap_dump_def(&params_def, 0);
+	void *round = tap_params_round(i, copy);
+	int n;
+
+	if (tap_param_overrides_count == 0) {
+		tap_params_current = round;
+		return;
+	}
+
+	if (round != copy) {
+		memcpy(copy, round, tap_rounds.size);
+	}
+	for (n = 0; n < tap_param_overrides_count; n++) {
+		memcpy((char*)copy + tap_param_overrides[n]->offset, 
+				tap_param_overrides[n]->override, 
+				tap_param_overrides[n]->size);
+	}
+	tap_params_current = copy;
+}
+
+static void tc_skip_string(const char **string)
+{
+	int escape = 0;
+
+	while (*++(*string)) switch (**string) {
+		case '\\':
+			escape = 1;
+			break;
+		case '"':
+			if (escape == 0) {
+				return;
+			}
+		default:
+			escape = 0;
+	}
+}
+
+/** Start of each TAP_PARAMS_VALUES in the values definition */
+static const char **tap_params_vals_index;
+static int tap_params_vals_indexed;
+
+/** Index the values definition, so rounds are found in a constant time */
+static void tap_params_vals_index_build(const char *vals_def)
+{
+	const char *start;
+	int size = 0;
+
+	for (start = vals_def; NULL != (start = strstr(start, 
+				"TAP_PARAMS_VALUES")); start++) {
+		if (tap_params_vals_indexed == size) {
+			size = 2 * size + 64;
+			tap_params_vals_index = realloc(tap_params_vals_index,
+					size * sizeof *tap_params_vals_index);
+		}
+		tap_params_vals_index[tap_params_vals_indexed++] = start;
+	}
+
+	if (tap_params_vals_index == NULL) {
+		tap_params_vals_index = malloc(sizeof *tap_params_vals_index);
+	}
+}
+
+/** Find the text of values of round num in vals_def
+ * @param len - length of the text
+ *
+ * @return the text or NULL, if the values are not defined literally
+ */
+static const char *tap_params_vals_text(const char *vals_def, int num, 
+		size_t *len)
+{
+	const char *start, *c;
+	int nested = 0;
+
+	if (tap_params_vals_index == NULL) {
+		tap_params_vals_index_build(vals_def);
+	}
+
+	if (num >= tap_params_vals_indexed) {
+		return NULL;
+	}
+	start = tap_params_vals_index[num];
+
+	start = index(start, '(');
+	if (start == NULL) {
+		return NULL;
+	}
+
+	for (c = start; *c; c++) switch (*c) {
+		case '"':
+			tc_skip_string(&c);
+			if (*c == 0) {
+				return NULL;
+			}
+			break;
+		case '(':
+			nested++;
+			break;
+		case ')':
+			if (--nested == 0) {
+				*len = c - start + 1;
+				return start;
+			}
+			break;
+	}
+
+	return NULL;
+}
+
+/** Designated initializer of one field in the text of a round */
+struct tap_params_field_s {
+	const char *name;
+	int name_len;
+	const char *val;
+	int val_len;
+};
+
+static struct tap_params_field_s *tap_params_fields;
+static int tap_params_fields_size;
+
+static struct tap_params_field_s *tap_params_field_add(int count)
+{
+	if (count == tap_params_fields_size) {
+		tap_params_fields_size = 2 * count + 8;
+		tap_params_fields = realloc(tap_params_fields,
+				tap_params_fields_size * 
+				sizeof *tap_params_fields);
+		if (tap_params_fields == NULL) {
+			BAIL_OUT("Out of memory");
+		}
+	}
+
+	return tap_params_fields + count;
+}
+
+/** Split text of TAP_PARAMS_VALUES (...) into fields in one pass
+ * @return number of fields stored into tap_params_fields
+ */
+static int tap_params_split_vals(const char *text, size_t len)
+{
+	struct tap_params_field_s *field = NULL;
+	const char *c, *end = text + len - 1;
+	int nested = 0;
+	int count = 0;
+
+	for (c = text + 1; c < end; c++) switch (*c) {
+		case '.':
+			if (nested || field) {
+				break;
+			}
+			field = tap_params_field_add(count++);
+			field->name = ++c;
+			while (c < end && (isalnum(*c) || *c == '_')) c++;
+			field->name_len = c - field->name;
+			while (c < end && *c != '=') c++;
+			for (c++; c < end && isblank(*c); c++);
+			field->val = c--;
+			break;
+		case '"':
+			tc_skip_string(&c);
+			break;
+		case '{':
+		case '(':
+			nested++;
+			break;
+		case '}':
+		case ')':
+			nested--;
+			break;
+		case ',':
+			if (nested == 0 && field) {
+				field->val_len = c - field->val;
+				field = NULL;
+			}
+			break;
+	}
+
+	if (field) {
+		field->val_len = end - field->val;
+	}
+
+	for (field = tap_params_fields; field < tap_params_fields + count; 
+			field++) {
+		while (field->val_len && isspace(field->val[field->val_len - 1])) {
+			field->val_len--;
+		}
+	}
+
+	return count;
+}
+
+/** Values of axes as they were written, indexed by axis and value */
+static struct tap_params_field_s **tap_params_axes_text;
+
+/** Split the written values of the axis at top level commas */
+static void tap_params_axis_split(tap_params_axis_t *axis, 
+		struct tap_params_field_s *vals)
+{
+	struct tap_params_field_s *field;
+	const char *c, *start;
+	unsigned long n = 0;
+	int nested = 0;
+
+	for (c = start = axis->def; n < axis->nmemb; c++) {
+		switch (*c) {
+			case '"':
+				tc_skip_string(&c);
+				break;
+			case '{':
+			case '(':
+				nested++;
+				break;
+			case '}':
+			case ')':
+				nested--;
+				break;
+		}
+
+		if (*c == '\0' || (*c == ',' && nested == 0)) {
+			field = vals + n++;
+			while (isspace(*start)) start++;
+			field->name = axis->name;
+			field->name_len = strlen(axis->name);
+			field->val = start;
+			field->val_len = c - start;
+			while (field->val_len && 
+			       isspace(field->val[field->val_len - 1])) {
+				field->val_len--;
+			}
+			if (*c == '\0') {
+				break;
+			}
+			start = c + 1;
+		}
+	}
+
+	for (; n < axis->nmemb; n++) {
+		vals[n].name = axis->name;
+		vals[n].name_len = strlen(axis->name);
+		vals[n].val = "?";
+		vals[n].val_len = 1;
+	}
+}
+
+static void tap_params_axes_index(void)
+{
+	int n;
+
+	if (tap_params_axes_text) {
+		return;
+	}
+
+	tap_params_axes_text = calloc(tap_rounds.naxes, 
+			sizeof *tap_params_axes_text);
+	if (tap_params_axes_text == NULL) {
+		BAIL_OUT("Out of memory");
+	}
+
+	for (n = 0; n < tap_rounds.naxes; n++) {
+		tap_params_axes_text[n] = calloc(tap_rounds.axes[n]->nmemb + 1, 
+				sizeof *tap_params_axes_text[n]);
+		if (tap_params_axes_text[n] == NULL) {
+			BAIL_OUT("Out of memory");
+		}
+		tap_params_axis_split(tap_rounds.axes[n], 
+				tap_params_axes_text[n]);
+	}
+}
+
+static void tap_params_dump_val(const char *name, int fields,
+		const char **val_str, int *val_len)
+{
+	int i;
+
+	// Fields of axes follow the shared values and take precedence
+	for (i = fields - 1; i >= 0; i--) {
+		if (tap_params_fields[i].name_len == strlen(name) &&
+		    0 == strncmp(tap_params_fields[i].name, name, 
+				    tap_params_fields[i].name_len)) {
+			*val_str = tap_params_fields[i].val;
+			*val_len = tap_params_fields[i].val_len;
+			return;
+		}
+	}
+
+	*val_str = "0";
+	*val_len = 1;
+}
+
+/** Diagnostic message printed with -v, ordered with results like diag() */
+static void tap_verbose_print(const char *fmt, ...)
+{
+	tap_line_t line;
+	va_list ap;
+
+	if (tap_verbose == 0) return;
+
+	tap_line_init(&line);
+	va_start(ap, fmt);
+	tap_line_vprintf(&line, fmt, ap);
+	va_end(ap);
+
+	diag("%s", line.buf);
+	tap_line_free(&line);
+}
+
+/** Add a value of the data file to fields of the dumped round */
+static void tap_data_field(int column, const char *value, const char *raw,
+		int raw_len, void *fields)
+{
+	struct tap_params_field_s *field;
+
+	field = tap_params_field_add((*(int*)fields)++);
+	field->name = tap_data.names[column];
+	field->name_len = strlen(tap_data.names[column]);
+	field->val = raw;
+	field->val_len = raw_len;
+}
+
+static void tap_params_dump_vals(const char *vals_def, 
+		unsigned long num)
+{
+	tap_param_desc_t *desc;
+	const char *text;
+	const char *val;
+	char buf[64], *end;
+	int val_len, fields, n, name_len = 0;
+	size_t len;
+
+	for (desc = tap_params_first; desc < tap_params_last; desc++) {
+		if (name_len < strlen(desc->name)) {
+			name_len = strlen(desc->name);
+		}
+	}
+
+	text = tap_params_vals_text(vals_def, 
+			tap_rounds.axes || tap_data.file ? 0 : num, &len);
+	fields = text ? tap_params_split_vals(text, len) : 0;
+
+	if (tap_data.file) {
+		tap_data_split(num, tap_data_field, &fields);
+	} else if (tap_rounds.axes) {
+		tap_params_axes_index();
+		for (n = tap_rounds.naxes - 1; n >= 0; n--) {
+			*tap_params_field_add(fields++) = tap_params_axes_text[n]
+					[num % tap_rounds.axes[n]->nmemb];
+			num /= tap_rounds.axes[n]->nmemb;
+		}
+	}
+
+	// Dump
+	for (desc = tap_params_first; desc < tap_params_last; desc++) {
+		tap_params_dump_val(desc->name, fields, &val, &val_len);
+
+		if (desc->override) {
+			switch (desc->type) {
+				case TAP_PARAM_STRING:
+					snprintf(buf, sizeof buf, "\"%s\" (default: ", *(char**)desc->override);
+					break;
+				case TAP_PARAM_CHAR:
+					sprintf(buf, "'%c' (default: ", *(char*)desc->override);
+					break;
+				default:
+					switch (desc->size) {
+						case 8:
+							sprintf(buf, "0x%llX (default: ", *(long long*)desc->override);
+							break;
+						case 4:
+							sprintf(buf, "0x%X (default: ", *(int*)desc->override);
+							break;
+						case 2:
+							sprintf(buf, "0x%X (default: ", *(unsigned short*)desc->override);
+							break;
+						case 1:
+							sprintf(buf, "0x%X (default: ", *(unsigned char*)desc->override);
+							break;
+					}
+			}
+			end = ")";
+		} else {
+			buf[0] = 0;
+			end = "";
+		}	
+
+		tap_verbose_print("% *s: %s%.*s%s", name_len, 
+				desc->name, buf, val_len, val, end);
+	}
+}
+
+int tap_param_skip(char *range)
+{
+	char *token;
+	unsigned long i;
+	int start, end;
+	char tmp;
+	static int disabled = 0;
+
+	if (disabled == 0) {
+		disabled = 1;
+		for (i = 0; i < tap_rounds.nmemb; i++) {
+			tap_params_skip_set(i, 1);
+		}
+	}
+
+	while (NULL != (token = strsep(&range, ","))) {
+		if (*token == 0) continue;
+		
+		if (index(token, '-')) {
+			if (2 != sscanf(token, "%d-%d%c", &start, &end, &tmp)) {
+				start = -1;
+			} else if (end < start) {
+				start = -1;
+			}
+		} else {
+			if (1 != sscanf(token, "%d%c", &start, &tmp)) {
+				start = -1;
+			} else {
+				end = start;
+			}
+		}
+
+		if (start < 0) {
+			return -1;
+		}
+
+		for (i = start; i < tap_rounds.nmemb && i <= end; i++) {
+			tap_params_skip_set(i, 0);
+		}
+	}
+
+	return 0;
+}
+
+/** FNV-1a hash of the text without whitespace */
+static unsigned long long tap_params_hash(unsigned long long hash, 
+		const char *text, size_t len)
+{
+	while (len--) {
+		if (!isspace(*text)) {
+			hash = (hash ^ (unsigned char)*text) * 1099511628211ULL;
+		}
+		text++;
+	}
+
+	return hash;
+}
+
+/** Skip rounds, which don't belong to the shard-th of shards shards
+ *
+ * Rounds are assigned to shards by a hash of their values, so they stay in
+ * the same shard when rounds are added or removed. Whitespace isn't hashed.
+ * Rounds of the matrix are hashed by the values of their axes, so they stay
+ * in the same shard when values are added to axes.
+ */
+void tap_param_shard(unsigned int shard, unsigned int shards, 
+		const char *vals_def)
+{
+	struct tap_params_field_s *field;
+	unsigned long long hash;
+	unsigned long i, k;
+	const char *text;
+	size_t len;
+	int n;
+
+	for (i = 0; i < tap_rounds.nmemb; i++) {
+		hash = 14695981039346656037ULL;
+		if (tap_rounds.axes) {
+			/* Values of axes, the shared values are the same */
+			tap_params_axes_index();
+			for (k = i, n = tap_rounds.naxes - 1; n >= 0; n--) {
+				field = tap_params_axes_text[n] + 
+						k % tap_rounds.axes[n]->nmemb;
+				k /= tap_rounds.axes[n]->nmemb;
+				hash = tap_params_hash(hash, field->name, 
+						field->name_len);
+				hash = tap_params_hash(hash, field->val, 
+						field->val_len);
+			}
+		} else if (tap_data.file) {
+			tap_data_seek(i);
+			hash = tap_params_hash(hash, tap_data.line, 
+					tap_data_eol(tap_data.line) - tap_data.line);
+		} else if (NULL != (text = tap_params_vals_text(vals_def, i, 
+						&len))) {
+			hash = tap_params_hash(hash, text, len);
+		} else {
+			hash = (hash ^ i) * 1099511628211ULL;
+		}
+
+		/* Low bits of FNV-1a depend on few bits of the text */
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+
+		if (hash % shards != shard) {
+			tap_params_skip_set(i, 1);
+		}
+	}
+}
+
+/** Combination of axes and which tuples of their values are covered */
+struct tap_cover_set_s {
+	int *axes;
+	unsigned long size;
+	unsigned long uncovered;
+	unsigned char *covered;
+};
+
+/** Rounds selected by the covering array, see tap_param_cover */
+static struct {
+	unsigned int strength;
+	unsigned long seed;
+	unsigned long rounds;
+	/** Bitset of the selected rounds, NULL if all rounds are executed */
+	unsigned long *selected;
+	/** Tuples, which are only in skipped rounds */
+	unsigned long long uncovered;
+	struct tap_cover_set_s *sets;
+	unsigned long nsets;
+} tap_cover;
+
+/** Random numbers, which are the same for the seed on every platform */
+static unsigned long long tap_cover_random(unsigned long long *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+/** Index of the tuple of values of the row in the set, -1 if the row
+ *  doesn't have all of them assigned */
+static long tap_cover_tuple(struct tap_cover_set_s *set, unsigned int t, 
+		const long *row)
+{
+	unsigned long tuple = 0;
+	int j;
+
+	for (j = 0; j < t; j++) {
+		if (row[set->axes[j]] < 0) {
+			return -1;
+		}
+		tuple = tuple * tap_rounds.axes[set->axes[j]]->nmemb + 
+				row[set->axes[j]];
+	}
+
+	return tuple;
+}
+
+/** Values of axes of the round */
+static void tap_cover_row(unsigned long round, long *row)
+{
+	int n;
+
+	for (n = tap_rounds.naxes - 1; n >= 0; n--) {
+		row[n] = round % tap_rounds.axes[n]->nmemb;
+		round /= tap_rounds.axes[n]->nmemb;
+	}
+}
+
+/** Round with the values of axes */
+static unsigned long tap_cover_round(const long *row)
+{
+	unsigned long round = 0;
+	int n;
+
+	for (n = 0; n < tap_rounds.naxes; n++) {
+		round = round * tap_rounds.axes[n]->nmemb + row[n];
+	}
+
+	return round;
+}
+
+/** Number of tuples the row would newly cover */
+static unsigned long tap_cover_gain(struct tap_cover_set_s *sets, 
+		unsigned long nsets, unsigned int t, const long *row)
+{
+	unsigned long gain = 0, s;
+	long tuple;
+
+	for (s = 0; s < nsets; s++) {
+		tuple = tap_cover_tuple(sets + s, t, row);
+		if (tuple >= 0 && sets[s].covered[tuple] == 0) {
+			gain++;
+		}
+	}
+
+	return gain;
+}
+
+/** Build a candidate row covering at least one uncovered tuple
+ *
+ * The row starts with a random uncovered tuple, remaining axes are assigned
+ * in a random order the value covering the most tuples with already assigned
+ * axes.
+ */
+static void tap_cover_candidate(struct tap_cover_set_s *sets, 
+		unsigned long nsets, unsigned int t, long *row, int *order, 
+		unsigned long long *state)
+{
+	struct tap_cover_set_s *set;
+	unsigned long s, tuple, gain, best_gain, v, nmemb;
+	long best;
+	int n, j, tmp;
+
+	s = tap_cover_random(state) % nsets;
+	while (sets[s].uncovered == 0) {
+		s = (s + 1) % nsets;
+	}
+	set = sets + s;
+
+	tuple = tap_cover_random(state) % set->size;
+	while (set->covered[tuple]) {
+		tuple = (tuple + 1) % set->size;
+	}
+
+	for (n = 0; n < tap_rounds.naxes; n++) {
+		row[n] = -1;
+		order[n] = n;
+	}
+	for (j = t - 1; j >= 0; j--) {
+		nmemb = tap_rounds.axes[set->axes[j]]->nmemb;
+		row[set->axes[j]] = tuple % nmemb;
+		tuple /= nmemb;
+	}
+
+	for (n = tap_rounds.naxes - 1; n > 0; n--) {
+		j = tap_cover_random(state) % (n + 1);
+		tmp = order[n], order[n] = order[j], order[j] = tmp;
+	}
+
+	for (n = 0; n < tap_rounds.naxes; n++) {
+		if (row[order[n]] >= 0) {
+			continue;
+		}
+
+		nmemb = tap_rounds.axes[order[n]]->nmemb;
+		best = tap_cover_random(state) % nmemb;
+		best_gain = 0;
+		for (v = 0; v < nmemb; v++) {
+			row[order[n]] = (best + v) % nmemb;
+			gain = tap_cover_gain(sets, nsets, t, row);
+			if (gain > best_gain) {
+				best_gain = gain;
+				best = row[order[n]];
+			}
+		}
+		row[order[n]] = best;
+	}
+}
+
+/** Execute only rounds of a covering array of the matrix
+ * @param strength - every combination of values of this many axes is
+ *                   executed at least once, 2 for pairwise testing
+ * @param seed - seed of the generator, the same seed selects the same rounds
+ *
+ * The array is built greedily, every round is the best of several random
+ * candidates. Rounds not in the array are skipped, so the executed rounds
+ * keep their numbers in the full matrix. Rounds already skipped (by -r or
+ * their skip field) aren't selected, tuples only they have are reported
+ * as not covered.
+ */
+void tap_param_cover(unsigned int strength, unsigned long seed)
+{
+	struct tap_cover_set_s *sets;
+	unsigned long long state = seed ^ 0x9E3779B97F4A7C15ULL;
+	unsigned long long uncovered = 0;
+	unsigned long nsets, s, i, round, rounds = 0, *selected;
+	unsigned long gain, best_gain;
+	long *row, *best;
+	int *axes, *order;
+	int n, j, c;
+
+	if (tap_rounds.axes == NULL) {
+		fprintf(stderr, "Option --cover requires parameters defined "
+				"by TAP_PARAMS_MATRIX\n");
+		exit(1);
+	}
+
+	tap_cover.strength = strength;
+	tap_cover.seed = seed;
+
+	if (strength >= tap_rounds.naxes) {
+		tap_cover.rounds = tap_rounds.nmemb;
+		return;
+	}
+
+	/* Number of combinations of strength axes */
+	for (nsets = 1, n = 0; n < strength; n++) {
+		nsets = nsets * (tap_rounds.naxes - n) / (n + 1);
+	}
+
+	sets = calloc(nsets, sizeof *sets);
+	axes = calloc(strength, sizeof *axes);
+	row = calloc(tap_rounds.naxes, sizeof *row);
+	best = calloc(tap_rounds.naxes, sizeof *best);
+	order = calloc(tap_rounds.naxes, sizeof *order);
+	selected = calloc(tap_rounds.nmemb / TAP_PARAMS_SKIP_BITS + 1, 
+			sizeof *selected);
+	if (!sets || !axes || !row || !best || !order || !selected) {
+		BAIL_OUT("Out of memory");
+	}
+
+	for (j = 0; j < strength; j++) {
+		axes[j] = j;
+	}
+	for (s = 0; s < nsets; s++) {
+		sets[s].axes = malloc(strength * sizeof *axes);
+		sets[s].size = 1;
+		for (j = 0; j < strength; j++) {
+			sets[s].axes[j] = axes[j];
+			sets[s].size *= tap_rounds.axes[axes[j]]->nmemb;
+		}
+		sets[s].uncovered = sets[s].size;
+		sets[s].covered = calloc(sets[s].size, 1);
+		if (!sets[s].axes || !sets[s].covered) {
+			BAIL_OUT("Out of memory");
+		}
+		uncovered += sets[s].size;
+
+		/* Next combination in the lexicographic order */
+		for (j = strength - 1; j >= 0 && 
+				axes[j] == tap_rounds.naxes - strength + j; j--);
+		if (j >= 0) {
+			for (axes[j]++; ++j < strength; axes[j] = axes[j - 1] + 1);
+		}
+	}
+
+	while (uncovered) {
+		best_gain = 0;
+		for (c = 0; c < 16; c++) {
+			tap_cover_candidate(sets, nsets, strength, row, order, 
+					&state);
+			if (TAP_PARAMS_SKIPPED(tap_rounds.skip, 
+						tap_cover_round(row))) {
+				continue;
+			}
+			gain = tap_cover_gain(sets, nsets, strength, row);
+			if (gain > best_gain) {
+				best_gain = gain;
+				memcpy(best, row, tap_rounds.naxes * sizeof *row);
+			}
+		}
+
+		/* Candidates were skipped, try every round, which isn't */
+		for (i = 0; best_gain == 0 && i < tap_rounds.nmemb; i++) {
+			if (tap_rounds.skip[i / TAP_PARAMS_SKIP_BITS] == ~0UL) {
+				i |= TAP_PARAMS_SKIP_BITS - 1;
+				continue;
+			} else if (TAP_PARAMS_SKIPPED(tap_rounds.skip, i)) {
+				continue;
+			}
+			tap_cover_row(i, row);
+			gain = tap_cover_gain(sets, nsets, strength, row);
+			if (gain > best_gain) {
+				best_gain = gain;
+				memcpy(best, row, tap_rounds.naxes * sizeof *row);
+			}
+		}
+
+		/* Tuples left are only in skipped rounds */
+		if (best_gain == 0) {
+			break;
+		}
+
+		for (s = 0; s < nsets; s++) {
+			i = tap_cover_tuple(sets + s, strength, best);
+			if (sets[s].covered[i] == 0) {
+				sets[s].covered[i] = 1;
+				sets[s].uncovered--;
+				uncovered--;
+			}
+		}
+
+		round = tap_cover_round(best);
+		selected[round / TAP_PARAMS_SKIP_BITS] |= 
+				1UL << round % TAP_PARAMS_SKIP_BITS;
+		rounds++;
+	}
+
+	for (i = 0; i <= tap_rounds.nmemb / TAP_PARAMS_SKIP_BITS; i++) {
+		tap_rounds.skip[i] |= ~selected[i];
+	}
+	tap_cover.rounds = rounds;
+	tap_cover.selected = selected;
+	tap_cover.uncovered = uncovered;
+	tap_cover.sets = sets;
+	tap_cover.nsets = nsets;
+
+	free(order);
+	free(best);
+	free(row);
+	free(axes);
+}
+
+/** Append values of axes of the row, only axes of the set if it's given */
+static void tap_cover_format(tap_line_t *line, const long *row, 
+		const struct tap_cover_set_s *set)
+{
+	struct tap_params_field_s *field;
+	int n, j;
+
+	tap_params_axes_index();
+	for (n = j = 0; n < tap_rounds.naxes; n++) {
+		if (set && (j == tap_cover.strength || set->axes[j] != n)) {
+			continue;
+		}
+		field = tap_params_axes_text[n] + row[n];
+		tap_line_printf(line, "%s%.*s: %.*s", j++ ? ", " : "", 
+				field->name_len, field->name, 
+				field->val_len, field->val);
+	}
+}
+
+/** Print the rounds selected by --cover and tuples it couldn't cover */
+static void tap_cover_report(void)
+{
+	struct tap_cover_set_s *set;
+	unsigned long i, tuple, k;
+	tap_line_t line;
+	long *row;
+	int j;
+
+	diag("Covering array of strength %u selects %lu of %lu rounds "
+			"(seed %lu)", tap_cover.strength, tap_cover.rounds, 
+			tap_rounds.nmemb, tap_cover.seed);
+
+	if (tap_cover.selected == NULL) {
+		return;
+	}
+
+	row = calloc(tap_rounds.naxes, sizeof *row);
+	if (row == NULL) {
+		BAIL_OUT("Out of memory");
+	}
+
+	for (i = 0; i < tap_rounds.nmemb; i++) {
+		if (TAP_PARAMS_SKIPPED(tap_cover.selected, i)) {
+			tap_line_init(&line);
+			tap_cover_row(i, row);
+			tap_cover_format(&line, row, NULL);
+			diag("  round %lu (%s)", i, line.buf);
+			tap_line_free(&line);
+		}
+	}
+
+	if (tap_cover.uncovered) {
+		diag("%llu tuples aren't covered, all their rounds are skipped", 
+				tap_cover.uncovered);
+	}
+
+	for (set = tap_cover.sets; set < tap_cover.sets + tap_cover.nsets; 
+			set++) {
+		for (tuple = 0; set->uncovered && tuple < set->size; tuple++) {
+			if (set->covered[tuple]) {
+				continue;
+			}
+			for (k = tuple, j = tap_cover.strength - 1; j >= 0; j--) {
+				row[set->axes[j]] = k % 
+						tap_rounds.axes[set->axes[j]]->nmemb;
+				k /= tap_rounds.axes[set->axes[j]]->nmemb;
+			}
+			tap_line_init(&line);
+			tap_cover_format(&line, row, set);
+			diag("  %s", line.buf);
+			tap_line_free(&line);
+		}
+		free(set->covered);
+		free(set->axes);
+	}
+
+	free(tap_cover.sets);
+	free(tap_cover.selected);
+	free(row);
+}
+
+/** Report the round, which is going to be executed or skipped */
+static void tap_params_round_info(const char *vals_def, unsigned long i)
+{
+	if (TAP_PARAMS_SKIPPED(tap_rounds.skip, i)) {
+		tap_verbose_print("Skipping round %lu", i);
+	} else {
+		tap_verbose_print("Starting round %lu", i);
+		tap_params_dump_vals(vals_def, i);
+	}
+}
+
+/** Execute the round, it's repeated with --repeat */
+static void tap_params_run(unsigned long i, int count)
+{
+	int j;
+
+	if (tap_flags & TAP_FLAGS_PERF) {
+		tap_perf_round_start();
+	}
+	tap_rusage_round_start();
+	tap_heap_round_start();
+
+	if (tap_repeat) {
+		tap_repeat_round(i, count);
+	} else for (j = 0; j < count; j++) {
+		tap_main(i);
+	}
+
+	tap_heap_round_done(i);
+	tap_rusage_round_done(i);
+	if (tap_flags & TAP_FLAGS_PERF) {
+		tap_perf_round_done(i);
+	}
+}
+
+/** Output of rounds, which finished before the rounds preceding them
+ *
+ * Round i is kept in slot i % window, if it's less than window rounds ahead
+ * of the first round not written. Output of rounds further ahead is spilled
+ * to a temporary file until it's their turn, so the scheduler can start any
+ * round without the memory growing with the number of rounds done ahead.
+ */
+struct tap_params_out_s {
+	/** Rounds before this one were written */
+	unsigned long emitted;
+	unsigned long window;
+	tap_capture_t *slots;
+	/** True for finished rounds */
+	char *done;
+	/** Output of rounds, which finished ahead of the window */
+	struct tap_params_spill_s {
+		off_t off;
+		size_t len;
+		/** The output, if it couldn't be written to the file */
+		tap_capture_t *capture;
+	} *spilled;
+	FILE *spill;
+	/** Spilled output read back to be written */
+	tap_capture_t reload;
+};
+
+static void tap_params_out_init(struct tap_params_out_s *out, 
+		unsigned long window)
+{
+	unsigned long i;
+
+	memset(out, 0, sizeof *out);
+	out->window = window;
+	out->slots = calloc(window, sizeof *out->slots);
+	out->done = calloc(tap_rounds.nmemb + 1, sizeof *out->done);
+	out->spilled = calloc(tap_rounds.nmemb + 1, sizeof *out->spilled);
+	if (!out->slots || !out->done || !out->spilled) {
+		BAIL_OUT("Out of memory");
+	}
+
+	for (i = 0; i < window; i++) {
+		tap_capture_init(out->slots + i);
+	}
+	tap_capture_init(&out->reload);
+}
+
+static void tap_params_out_free(struct tap_params_out_s *out)
+{
+	unsigned long i;
+
+	for (i = 0; i < out->window; i++) {
+		tap_capture_free(out->slots + i);
+	}
+	tap_capture_free(&out->reload);
+
+	if (out->spill) {
+		fclose(out->spill);
+	}
+
+	free(out->spilled);
+	free(out->done);
+	free(out->slots);
+}
+
+/** Capture of round i or NULL, if the round is ahead of the window and it's
+ *  captured elsewhere until it's passed to tap_params_out_done() */
+static tap_capture_t *tap_params_out_slot(struct tap_params_out_s *out, 
+		unsigned long i)
+{
+	if (i >= out->emitted + out->window) {
+		return NULL;
+	}
+
+	return out->slots + i % out->window;
+}
+
+/** Note round i finished, its output is moved from capture to the slot or
+ *  to the spill file, unless it was captured in the slot
+ * @return 0 or -1 if there isn't memory for the output
+ */
+static int tap_params_out_done(struct tap_params_out_s *out, unsigned long i,
+		tap_capture_t *capture)
+{
+	struct tap_params_spill_s *spilled = out->spilled + i;
+	tap_capture_t *slot = tap_params_out_slot(out, i);
+	size_t len = capture->buf.len;
+
+	if (slot == NULL) {
+		if (out->spill == NULL) {
+			out->spill = tmpfile();
+		}
+		if (out->spill && 0 == fseeko(out->spill, 0, SEEK_END) && 
+		    (spilled->off = ftello(out->spill)) >= 0 && 
+		    len == fwrite(capture->buf.buf, 1, len, out->spill)) {
+			spilled->len = len;
+		} else {
+			/* Keep it in memory */
+			slot = spilled->capture = malloc(sizeof *slot);
+			if (slot == NULL) {
+				return -1;
+			}
+			tap_capture_init(slot);
+		}
+	}
+
+	if (slot && slot != capture) {
+		tap_line_write(&slot->buf, capture->buf.buf, len);
+	}
+	if (slot != capture) {
+		capture->buf.len = 0;
+	}
+
+	out->done[i] = 1;
+	return 0;
+}
+
+/** Output of round i, the first round not written yet, or NULL if it isn't
+ *  finished */
+static tap_capture_t *tap_params_out_take(struct tap_params_out_s *out, 
+		unsigned long i)
+{
+	struct tap_params_spill_s *spilled = out->spilled + i;
+	char buf[4096];
+	size_t len, n;
+
+	if (!out->done[i]) {
+		return NULL;
+	} else if (spilled->capture) {
+		return spilled->capture;
+	} else if (spilled->len == 0) {
+		return out->slots + i % out->window;
+	}
+
+	/* A truncated record is dropped by tap_capture_next() */
+	out->reload.buf.len = 0;
+	if (0 == fseeko(out->spill, spilled->off, SEEK_SET)) {
+		for (len = spilled->len; len > 0; len -= n) {
+			n = fread(buf, 1, len < sizeof buf ? len : sizeof buf, 
+					out->spill);
+			if (n == 0) {
+				break;
+			}
+			tap_line_write(&out->reload.buf, buf, n);
+		}
+	}
+
+	return &out->reload;
+}
+
+/** Release the output of round i, once it was written */
+static void tap_params_out_release(struct tap_params_out_s *out, 
+		unsigned long i)
+{
+	struct tap_params_spill_s *spilled = out->spilled + i;
+
+	if (spilled->capture) {
+		tap_capture_free(spilled->capture);
+		free(spilled->capture);
+		spilled->capture = NULL;
+	}
+
+	tap_capture_free(out->slots + i % out->window);
+	tap_capture_init(out->slots + i % out->window);
+}
+
+#ifdef HAVE_LIBPTHREAD
+
+/** Rounds executed by a pool of worker threads */
+struct tap_params_pool_s {
+	int count;
+	char *vals_def;
+	tap_sched_t *sched;
+	/** Output of rounds, it's written in the order of rounds */
+	struct tap_params_out_s out;
+	/** True, if the pool has no threads and its worker writes rounds */
+	int inline_emit;
+	/** Round, which bailed out, or -1. Later rounds aren't executed */
+	long bail;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/** Worker of the pool */
+struct tap_params_worker_s {
+	struct tap_params_pool_s *pool;
+	int id;
+};
+
+/** Pool of the worker thread, the round it executes and its capture */
+static __thread struct tap_params_pool_s *tap_params_worker_pool;
+static __thread long tap_params_worker_round;
+static __thread tap_capture_t *tap_params_worker_capture;
+
+/** Write finished rounds in their order, wait for the rest if wait is set */
+static void tap_params_pool_emit(struct tap_params_pool_s *pool, int wait)
+{
+	tap_capture_t *capture;
+	unsigned long i;
+
+	pthread_mutex_lock(&pool->lock);
+	while ((i = pool->out.emitted) < tap_rounds.nmemb) {
+		if (!TAP_PARAMS_SKIPPED(tap_rounds.skip, i)) {
+			capture = tap_params_out_take(&pool->out, i);
+			if (capture == NULL) {
+				if (!wait) {
+					break;
+				}
+				pthread_cond_wait(&pool->cond, &pool->lock);
+				continue;
+			}
+			pthread_mutex_unlock(&pool->lock);
+
+			tap_params_round_info(pool->vals_def, i);
+			tap_capture_emit(capture);
+
+			pthread_mutex_lock(&pool->lock);
+			tap_params_out_release(&pool->out, i);
+		}
+		pool->out.emitted = i + 1;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/** Note the round of the worker finished with the output in capture */
+static void tap_params_pool_done(struct tap_params_pool_s *pool, 
+		unsigned long i, tap_capture_t *capture)
+{
+	int rtn;
+
+	pthread_mutex_lock(&pool->lock);
+	rtn = tap_params_out_done(&pool->out, i, capture);
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	if (rtn) {
+		BAIL_OUT("Out of memory");
+	}
+}
+
+static void *tap_params_worker(void *arg)
+{
+	struct tap_params_pool_s *pool = ((struct tap_params_worker_s*)arg)->pool;
+	int id = ((struct tap_params_worker_s*)arg)->id;
+	void *copy = malloc(tap_rounds.size);
+	tap_capture_t ahead, *capture;
+	unsigned long long start;
+	long i, bail;
+
+	if (copy == NULL) {
+		BAIL_OUT("Out of memory");
+	}
+
+	tap_capture_init(&ahead);
+	tap_params_worker_pool = pool;
+
+	while ((i = tap_sched_next(pool->sched, id)) >= 0) {
+		pthread_mutex_lock(&pool->lock);
+		bail = pool->bail;
+		capture = tap_params_out_slot(&pool->out, i);
+		pthread_mutex_unlock(&pool->lock);
+
+		if (bail >= 0 && i > bail) {
+			/* Nothing after the bail out is written */
+			continue;
+		} else if (capture == NULL) {
+			/* Too far ahead, it's spilled once it's finished */
+			capture = &ahead;
+		}
+
+		tap_params_enter(i, copy);
+		tap_capture = capture;
+		tap_params_worker_capture = capture;
+		tap_params_worker_round = i;
+
+		start = tap_sched_now();
+		tap_round_start(i);
+		tap_params_run(i, pool->count);
+		start = tap_sched_now() - start;
+		tap_sched_done(pool->sched, i, start);
+		tap_round_done(i, start);
+
+		tap_capture = NULL;
+		tap_params_pool_done(pool, i, capture);
+
+		if (pool->inline_emit) {
+			tap_params_pool_emit(pool, 0);
+		}
+	}
+
+	tap_params_worker_pool = NULL;
+	tap_capture_free(&ahead);
+	free(copy);
+	return NULL;
+}
+
+/** Execute rounds by jobs threads
+ *
+ * Workers capture the output of rounds and the main thread writes it in the
+ * order of rounds, so the test numbers are assigned as if the rounds were
+ * executed sequentially. Workers take any round the scheduler gives them,
+ * output of rounds finished far ahead of the first round not written waits
+ * in a temporary file, see tap_params_out_s.
+ */
+static void tap_params_parallel(char *vals_def, int count, int jobs, 
+		const char *timings)
+{
+	struct tap_params_pool_s pool = {
+		.count = count,
+		.vals_def = vals_def,
+		.bail = -1,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	struct tap_params_worker_s *args;
+	pthread_t *workers;
+	int n;
+
+	workers = calloc(jobs, sizeof *workers);
+	args = calloc(jobs, sizeof *args);
+	if (!workers || !args) {
+		BAIL_OUT("Out of memory");
+	}
+
+	tap_params_out_init(&pool.out, jobs * TAP_PARAMS_WINDOW);
+
+	pool.sched = tap_sched_create(tap_rounds.skip, tap_rounds.nmemb, 
+			jobs, timings);
+
+	/* Fast passes would be reported before the rounds they belong to */
+	__atomic_add_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+
+	for (n = 0; n < jobs; n++) {
+		args[n].pool = &pool;
+		args[n].id = n;
+		if (pthread_create(workers + n, NULL, tap_params_worker, 
+					args + n)) {
+			break;
+		}
+	}
+
+	/* Rounds queued for workers, which didn't start, are stolen */
+	if (n == 0) {
+		pool.inline_emit = 1;
+		tap_params_worker(args);
+	}
+
+	tap_params_pool_emit(&pool, 1);
+
+	while (n-- > 0) {
+		pthread_join(workers[n], NULL);
+	}
+
+	__atomic_sub_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+
+	tap_sched_finish(pool.sched);
+
+	tap_params_out_free(&pool.out);
+	free(args);
+	free(workers);
+}
+#endif // HAVE_LIBPTHREAD
+
+/** Finish the round of a worker thread by the bail out message
+ * @param msg - the bail out line
+ * @param len - length of the line
+ *
+ * The message is written after the output of the preceding rounds, then the
+ * process exits. It returns only if the thread isn't a worker of the pool.
+ */
+void tap_params_worker_bail(const char *msg, size_t len)
+{
+#ifdef HAVE_LIBPTHREAD
+	struct tap_params_pool_s *pool = tap_params_worker_pool;
+	long round = tap_params_worker_round;
+
+	if (pool == NULL) {
+		return;
+	}
+
+	/* A bail out while the round is being put aside is written directly */
+	tap_params_worker_pool = NULL;
+	tap_capture = NULL;
+	tap_capture_put(tap_params_worker_capture, TAP_REC_BAIL, msg, len);
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->bail < 0 || pool->bail > round) {
+		pool->bail = round;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	tap_params_pool_done(pool, round, tap_params_worker_capture);
+
+	/* Preceding rounds were written, the emitter exits on the message */
+	if (pool->inline_emit) {
+		tap_params_pool_emit(pool, 0);
+	}
+
+	pthread_exit(NULL);
+#endif // HAVE_LIBPTHREAD
+}
+
+/** Round executed by a forked process */
+struct tap_params_child_s {
+	pid_t pid;
+	/** Read end of the pipe with the captured output, -1 once it's closed */
+	int fd;
+	/** Exit status of the process */
+	int status;
+	/** When the process was started */
+	unsigned long long start;
+	tap_capture_t capture;
+};
+
+/** Execute round i in a child process, which streams its output back */
+static int tap_params_fork(struct tap_params_child_s *child, 
+		unsigned long i, int count)
+{
+	void *copy;
+	int fds[2];
+
+	if (pipe(fds)) {
+		return -1;
+	}
+
+	tap_capture_init(&child->capture);
+
+	child->pid = fork();
+	if (child->pid == 0) {
+		close(fds[0]);
+		tap_capture = &child->capture;
+		tap_capture_stream(tap_capture, fds[1]);
+
+		copy = malloc(tap_rounds.size);
+		if (copy == NULL) {
+			BAIL_OUT("Out of memory");
+		}
+		tap_params_enter(i, copy);
+
+		tap_round_start(i);
+		tap_params_run(i, count);
+
+		tap_capture_put(tap_capture, TAP_REC_END, NULL, 0);
+		tap_capture_flush(tap_capture);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	if (child->pid < 0) {
+		close(fds[0]);
+		return -1;
+	}
+
+	child->fd = fds[0];
+	return 0;
+}
+
+/** Read output of the child, return 0 once the child finished */
+static int tap_params_child_read(struct tap_params_child_s *child)
+{
+	char buf[4096];
+	ssize_t rtn;
+
+	rtn = read(child->fd, buf, sizeof buf);
+	if (rtn > 0) {
+		tap_line_write(&child->capture.buf, buf, rtn);
+		return 1;
+	} else if (rtn < 0 && errno == EINTR) {
+		return 1;
+	}
+
+	close(child->fd);
+	child->fd = -1;
+
+	while (waitpid(child->pid, &child->status, 0) < 0 && errno == EINTR);
+
+	return 0;
+}
+
+/** Complete output of a forked round, tests it didn't get to fail */
+static void tap_params_child_finish(struct tap_params_child_s *child, 
+		int i, int planned)
+{
+	char reason[64], line[128];
+	const char *data;
+	size_t pos = 0, len;
+	tap_rec_t kind;
+	int tests = 0, ended = 0, n;
+
+	while (NULL != (data = tap_capture_next(&child->capture, &pos, 
+					&kind, &len))) {
+		if (kind == TAP_REC_END) {
+			ended = 1;
+		} else if (kind != TAP_REC_OUT && kind != TAP_REC_ERR) {
+			tests++;
+		}
+	}
+
+	if (!ended) {
+		if (WIFSIGNALED(child->status)) {
+			for (n = 0; n < sizeof signals/sizeof signals[0]; n++) {
+				if (signals[n].sig == WTERMSIG(child->status)) {
+					break;
+				}
+			}
+			if (n < sizeof signals/sizeof signals[0]) {
+				snprintf(reason, sizeof reason, "killed by %s", 
+						signals[n].name);
+			} else {
+				snprintf(reason, sizeof reason, 
+						"killed by signal %d", 
+						WTERMSIG(child->status));
+			}
+		} else {
+			snprintf(reason, sizeof reason, "exited with status %d",
+					WEXITSTATUS(child->status));
+		}
+
+		for (; tests < planned; tests++) {
+			len = snprintf(line, sizeof line, " - round %d %s\n", 
+					i, reason);
+			tap_capture_put(&child->capture, TAP_REC_NOT_OK, 
+					line, len);
+		}
+
+		len = snprintf(line, sizeof line, "#     Round %d %s\n", 
+				i, reason);
+		tap_capture_put(&child->capture, TAP_REC_ERR, line, len);
+	}
+}
+
+/** Execute every round in a child process, at most jobs of them at once
+ *
+ * Rounds are reported in their order. A crash or exit of the child fails
+ * the tests it didn't run, but the following rounds are executed normally.
+ * Output of rounds waits for its turn like with threads, see 
+ * tap_params_out_s.
+ */
+static void tap_params_isolated(char *vals_def, int count, int jobs, 
+		const char *timings)
+{
+	struct tap_params_child_s *children, *child;
+	struct tap_params_out_s out;
+	struct pollfd *fds;
+	tap_params_header_t *hdr;
+	tap_capture_t *capture;
+	tap_sched_t *sched;
+	void *buf;
+	long *slots, round;
+	int running = 0, n, slot, skipped;
+
+	children = calloc(jobs, sizeof *children);
+	fds = calloc(jobs, sizeof *fds);
+	slots = calloc(jobs, sizeof *slots);
+	buf = malloc(tap_rounds.size);
+	if (!children || !fds || !slots || !buf) {
+		BAIL_OUT("Out of memory");
+	}
+
+	for (slot = 0; slot < jobs; slot++) {
+		slots[slot] = -1;
+	}
+
+	tap_params_out_init(&out, jobs * TAP_PARAMS_WINDOW);
+
+	sched = tap_sched_create(tap_rounds.skip, tap_rounds.nmemb, jobs, 
+			timings);
+
+	/* Fast passes of children would be lost */
+	__atomic_add_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+
+	while (out.emitted < tap_rounds.nmemb) {
+		for (slot = 0; slot < jobs; slot++) {
+			if (slots[slot] >= 0 || 
+			    (round = tap_sched_next(sched, slot)) < 0) {
+				continue;
+			}
+
+			child = children + slot;
+			child->start = tap_sched_now();
+			if (tap_params_fork(child, round, count)) {
+				BAIL_OUT("Can't execute round %ld: %s", round, 
+						strerror(errno));
+			}
+			slots[slot] = round;
+			running++;
+		}
+
+		for (; out.emitted < tap_rounds.nmemb; out.emitted++) {
+			skipped = TAP_PARAMS_SKIPPED(tap_rounds.skip, 
+					out.emitted);
+			capture = skipped ? NULL : 
+				tap_params_out_take(&out, out.emitted);
+			if (!skipped && capture == NULL) {
+				break;
+			}
+
+			tap_params_round_info(vals_def, out.emitted);
+			if (capture) {
+				tap_capture_emit(capture);
+				tap_params_out_release(&out, out.emitted);
+			}
+		}
+
+		if (running == 0) {
+			continue;
+		}
+
+		for (n = 0, slot = 0; slot < jobs; slot++) {
+			if (slots[slot] >= 0) {
+				fds[n].fd = children[slot].fd;
+				fds[n++].events = POLLIN;
+			}
+		}
+
+		if (poll(fds, n, -1) < 0) {
+			continue;
+		}
+
+		for (n = 0, slot = 0; slot < jobs; slot++) {
+			if (slots[slot] < 0 || fds[n++].revents == 0) {
+				continue;
+			}
+
+			child = children + slot;
+			if (tap_params_child_read(child) == 0) {
+				child->start = tap_sched_now() - child->start;
+				tap_sched_done(sched, slots[slot], child->start);
+				tap_round_done(slots[slot], child->start);
+
+				hdr = tap_params_round(slots[slot], buf);
+				tap_params_child_finish(child, slots[slot], 
+						tap_repeat ? 1 : 
+						hdr->plan * count);
+				if (tap_params_out_done(&out, slots[slot], 
+							&child->capture)) {
+					BAIL_OUT("Out of memory");
+				}
+				tap_capture_free(&child->capture);
+				slots[slot] = -1;
+				running--;
+			}
+		}
+	}
+
+	__atomic_sub_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+
+	tap_sched_finish(sched);
+
+	tap_params_out_free(&out);
+	free(buf);
+	free(slots);
+	free(fds);
+	free(children);
+}
+
+void tap_params_main(char *vals_def, int count, 
+		int jobs, int isolate, const char *timings)
+{
+	void *copy = malloc(tap_rounds.size);
+	unsigned long long start;
+	unsigned long i;
+	int tc_count = 0;
+	int rounds = 0;
+
+	if (copy == NULL) {
+		BAIL_OUT("Out of memory");
+	}
+
+	for (i = 0; i < tap_rounds.nmemb; i++) {
+		if (TAP_PARAMS_SKIPPED(tap_rounds.skip, i)) {
+			continue;
+		}
+		rounds++;
+		if (tap_data.file && !tap_data.plan) {
+			/* Rounds in the file don't need to be parsed */
+			tc_count += ((tap_params_header_t*)tap_rounds.vals)->plan;
+		} else {
+			tc_count += ((tap_params_header_t*)
+					tap_params_round(i, copy))->plan;
+		}
+	}
+	
+	tap_init(tap_flags);
+
+	if (tc_count == 0) {
+		plan_skip_all("No parameters set selected");
+	}
+
+	/* Repeated rounds are reported by one test each */
+	tap_repeat_init();
+	plan_tests(tap_repeat ? rounds : tc_count * count);
+
+	if (tap_cover.strength) {
+		tap_cover_report();
+	}
+
+	if (isolate) {
+		tap_params_isolated(vals_def, count, jobs, timings);
+#ifdef HAVE_LIBPTHREAD
+	} else if (jobs > 1) {
+		tap_params_parallel(vals_def, count, jobs, timings);
+#endif
+	} else for (i = 0; i < tap_rounds.nmemb; i++) {
+		tap_params_round_info(vals_def, i);
+		if (TAP_PARAMS_SKIPPED(tap_rounds.skip, i)) {
+			continue;
+		}
+
+		tap_params_enter(i, copy);
+		start = tap_sched_now();
+		tap_round_start(i);
+		tap_params_run(i, count);
+		tap_round_done(i, tap_sched_now() - start);
+	}
+	free(copy);
+
+	tap_round_report();
+	tap_heap_report();
+}
+
+void tap_params_info(void)
+{
+	const tap_param_desc_t *desc;
+
+	if (tap_params_first == tap_params_last) {
+		printf("This test case does not have any parameters defined.\n");
+		return;
+	}
+
+	printf("Parameters:\n");
+	for (desc = tap_params_first; desc < tap_params_last; desc++) {
+		printf("  %s%s%s;\n", desc->decl, 
+				desc->decl[strlen(desc->decl) - 1] == '*' ? 
+				"" : " ", desc->name);
 	}
 }
@@ -27,18 +27,40 @@
 #ifndef TAP_PARAMS_H
 #define TAP_PARAMS_H
 
+#include <stddef.h>
+
+/** Bits in one word of the bitset of skipped rounds */
+#define TAP_PARAMS_SKIP_BITS (8 * sizeof(unsigned long))
+
+/** True, if round i is skipped according to the bitset */
+#define TAP_PARAMS_SKIPPED(skip, i) \
+	((skip)[(i) / TAP_PARAMS_SKIP_BITS] >> (i) % TAP_PARAMS_SKIP_BITS & 1)
+
+/** Rounds per job kept in memory, when they finish before the rounds 
+ *  preceding them, see tap_params_out_s */
+#define TAP_PARAMS_WINDOW 64
+
 void tap_params_init(const char *params_def);
 
+void tap_params_rounds(void *vals, unsigned long vals_size, 
+		unsigned long vals_nmemb);
+
 void tap_params_info(void);
 
 void tap_param_override(const char *name, const char *value);
 
-int tap_param_skip(char *range, void *vals, unsigned long vals_size, 
-		unsigned long vals_nmemb);
+int tap_param_skip(char *range);
+
+void tap_param_shard(unsigned int shard, unsigned int shards, 
+		const char *vals_def);
+
+void tap_params_data(const char *file);
+
+void tap_param_cover(unsigned int strength, unsigned long seed);
+
+void tap_params_worker_bail(const char *msg, size_t len);
 
-void tap_params_main(char *params_def, char *vals_def, 
-		void *vals, void **current, 
-		unsigned long vals_size, unsigned long vals_nmemb, 
-		int count);
+void tap_params_main(char *vals_def, int count, 
+		int jobs, int isolate, const char *timings);
 
 #endif /* TAP_PARAMS_H */
@@ -0,0 +1,331 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_bench.h"
+#include "tap_main.h"
+#include "tap_perf.h"
+#include "tap.h"
+
+/** PERF_TYPE_HW_CACHE config of read misses of the cache */
+#define TAP_PERF_CACHE_MISS(cache) \
+	((cache) | PERF_COUNT_HW_CACHE_OP_READ << 8 | \
+	 PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+/** Events in the order of tap_perf_event_t */
+static const struct tap_perf_desc_s {
+	const char *name;
+	unsigned int type;
+	unsigned long long config;
+} tap_perf_desc[TAP_PERF_EVENTS] = {
+	{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ "l1d_misses", PERF_TYPE_HW_CACHE, 
+		TAP_PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+	{ "llc_misses", PERF_TYPE_HW_CACHE, 
+		TAP_PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+	{ "dtlb_misses", PERF_TYPE_HW_CACHE, 
+		TAP_PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+/** Counters of a thread */
+static __thread struct tap_perf_thread_s {
+	/** 0 if counters weren't opened, 1 if they were, -1 if none works */
+	int state;
+	int fd[TAP_PERF_EVENTS];
+	/** Values at the start of the round */
+	tap_perf_counts_t round;
+	/** Values at the end of the last test */
+	tap_perf_counts_t last;
+} tap_perf_thread;
+
+/** True, once unavailable counters were reported */
+static int tap_perf_reported;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_once_t tap_perf_once = PTHREAD_ONCE_INIT;
+
+/** Counters are closed, when their thread exits */
+static pthread_key_t tap_perf_key;
+#endif
+
+static void tap_perf_close(void *arg)
+{
+	struct tap_perf_thread_s *thread = arg;
+	int i;
+
+	for (i = 0; i < TAP_PERF_EVENTS; i++) {
+		if (thread->state > 0 && thread->fd[i] >= 0) {
+			close(thread->fd[i]);
+		}
+	}
+	thread->state = 0;
+}
+
+/** Counters inherited by a forked child count its parent */
+static void tap_perf_fork_child(void)
+{
+	tap_perf_close(&tap_perf_thread);
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void tap_perf_key_init(void)
+{
+	pthread_key_create(&tap_perf_key, tap_perf_close);
+	pthread_atfork(NULL, NULL, tap_perf_fork_child);
+}
+#endif
+
+/** Open counters of the thread, events which can't be counted are left out
+ *
+ * Only the user space of the calling thread is counted, what is allowed with
+ * the default perf_event_paranoid. Counters, which don't fit in the PMU, are
+ * multiplexed and their values are scaled.
+ */
+static void tap_perf_open(void)
+{
+	struct tap_perf_thread_s *thread = &tap_perf_thread;
+	struct perf_event_attr attr;
+	int i, err = 0;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_once(&tap_perf_once, tap_perf_key_init);
+	pthread_setspecific(tap_perf_key, thread);
+#endif
+
+	thread->state = -1;
+	for (i = 0; i < TAP_PERF_EVENTS; i++) {
+		memset(&attr, 0, sizeof attr);
+		attr.size = sizeof attr;
+		attr.type = tap_perf_desc[i].type;
+		attr.config = tap_perf_desc[i].config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | 
+				PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		thread->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 
+				PERF_FLAG_FD_CLOEXEC);
+		if (thread->fd[i] >= 0) {
+			thread->state = 1;
+		} else {
+			err = errno;
+		}
+	}
+
+	if (thread->state < 0 && (tap_flags & TAP_FLAGS_PERF) && 
+	    !__atomic_exchange_n(&tap_perf_reported, 1, __ATOMIC_RELAXED)) {
+		diag("Performance counters aren't available: %s", 
+				strerror(err));
+	}
+}
+
+/** Read counters of the thread, they are opened on the first use */
+void tap_perf_read(tap_perf_counts_t *counts)
+{
+	struct tap_perf_thread_s *thread = &tap_perf_thread;
+	unsigned long long buf[3];
+	int i;
+
+	if (thread->state == 0) {
+		tap_perf_open();
+	}
+
+	counts->valid = 0;
+	for (i = 0; thread->state > 0 && i < TAP_PERF_EVENTS; i++) {
+		if (thread->fd[i] < 0 || 
+		    read(thread->fd[i], buf, sizeof buf) != sizeof buf || 
+		    buf[2] == 0) {
+			continue;
+		}
+		counts->v[i] = buf[2] == buf[1] ? buf[0] : 
+				(unsigned long long)((double)buf[0] * buf[1] / 
+						buf[2]);
+		counts->valid |= 1 << i;
+	}
+}
+
+/** Open counters of the main thread, so unavailability is reported once 
+ *  and not by every forked process */
+void tap_perf_init(void)
+{
+	tap_perf_counts_t counts;
+
+	tap_perf_read(&counts);
+}
+
+/** Difference of counters, events counted in both are valid */
+void tap_perf_delta(tap_perf_counts_t *delta, const tap_perf_counts_t *start,
+		const tap_perf_counts_t *end)
+{
+	int i;
+
+	delta->valid = start->valid & end->valid;
+	for (i = 0; i < TAP_PERF_EVENTS; i++) {
+		delta->v[i] = end->v[i] - start->v[i];
+	}
+}
+
+/** Count events of the round from now */
+void tap_perf_round_start(void)
+{
+	tap_perf_read(&tap_perf_thread.round);
+	tap_perf_thread.last = tap_perf_thread.round;
+}
+
+/** Print counters of the round, which just finished */
+void tap_perf_round_done(unsigned long round)
+{
+	tap_perf_counts_t now, delta;
+	tap_line_t line;
+	int i;
+
+	tap_perf_read(&now);
+	tap_perf_delta(&delta, &tap_perf_thread.round, &now);
+	if (delta.valid == 0) {
+		return;
+	}
+
+	tap_line_init(&line);
+	for (i = 0; i < TAP_PERF_EVENTS; i++) {
+		if (delta.valid & 1 << i) {
+			tap_line_printf(&line, " %s %llu", 
+					tap_perf_desc[i].name, delta.v[i]);
+		}
+	}
+	diag("Round %lu:%s", round, line.buf);
+	tap_line_free(&line);
+}
+
+/** Counters of the test, which just finished, since the previous test of
+ *  the thread or since the start of its round */
+void tap_perf_test(tap_perf_counts_t *delta)
+{
+	tap_perf_counts_t now;
+
+	tap_perf_read(&now);
+	tap_perf_delta(delta, &tap_perf_thread.last, &now);
+	tap_perf_thread.last = now;
+}
+
+/** Convert valid counters divided by per to values, others are negative */
+void tap_perf_values(double *vals, const tap_perf_counts_t *counts, 
+		double per)
+{
+	int i;
+
+	for (i = 0; i < TAP_PERF_EVENTS; i++) {
+		vals[i] = counts->valid & 1 << i ? counts->v[i] / per : -1;
+	}
+}
+
+/** Append values as a YAMLish map, negative values are left out */
+void tap_perf_format(tap_line_t *out, const char *title, const double *vals,
+		int precision)
+{
+	int i, empty = 1;
+
+	for (i = 0; i < TAP_PERF_EVENTS; i++) {
+		if (vals[i] < 0) {
+			continue;
+		}
+		if (empty) {
+			tap_line_printf(out, "  %s:\n", title);
+			empty = 0;
+		}
+		tap_line_printf(out, "    %s: %.*f\n", tap_perf_desc[i].name, 
+				precision, vals[i]);
+	}
+}
+
+/** Read the counter of the thread
+ * @return the number of events since the first use in the thread or 0 if
+ *         the event can't be counted
+ */
+unsigned long long tap_perf(tap_perf_event_t event)
+{
+	tap_perf_counts_t counts;
+
+	tap_perf_read(&counts);
+
+	return counts.valid & 1 << event ? counts.v[event] : 0;
+}
+
+/** True, if the event is counted in this thread */
+int tap_perf_available(tap_perf_event_t event)
+{
+	tap_perf_counts_t counts;
+
+	tap_perf_read(&counts);
+
+	return !!(counts.valid & 1 << event);
+}
+
+int ok_max_perf_f(tap_perf_event_t event, double max, const char *func, 
+		const char *file, unsigned int line, const char *fmt, ...)
+{
+	double got = tap_bench_perf(event);
+	tap_line_t name;
+	va_list ap;
+	int rtn;
+
+	tap_line_init(&name);
+	if (*fmt) {
+		va_start(ap, fmt);
+		tap_line_vprintf(&name, fmt, ap);
+		va_end(ap);
+	} else {
+		tap_line_printf(&name, "At most %g %s per iteration", max, 
+				tap_perf_desc[event].name);
+	}
+
+	if (tap_bench_last == NULL) {
+		diag("    No benchmark was run before the test of %s", 
+				tap_perf_desc[event].name);
+		rtn = _gen_result(0, NULL, func, file, line, "%s", name.buf);
+	} else if (got < 0) {
+		rtn = skip_f(1, "%s aren't counted", 
+				tap_perf_desc[event].name);
+	} else {
+		rtn = tap_bench_compare_result(got <= max, got, max, "<=", 
+				func, file, line, "%s", name.buf);
+	}
+
+	tap_line_free(&name);
+
+	return rtn;
+}
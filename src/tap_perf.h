@@ -0,0 +1,59 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_PERF_H
+#define TAP_PERF_H
+
+#include "tap_output.h"
+#include "tap.h"
+
+/** Values of counters of a thread */
+typedef struct tap_perf_counts_s {
+	unsigned long long v[TAP_PERF_EVENTS];
+	/** Bit mask of counted events */
+	unsigned int valid;
+} tap_perf_counts_t;
+
+void tap_perf_init(void);
+
+void tap_perf_read(tap_perf_counts_t *counts);
+
+void tap_perf_delta(tap_perf_counts_t *delta, const tap_perf_counts_t *start,
+		const tap_perf_counts_t *end);
+
+void tap_perf_round_start(void);
+
+void tap_perf_round_done(unsigned long round);
+
+void tap_perf_test(tap_perf_counts_t *delta);
+
+void tap_perf_values(double *vals, const tap_perf_counts_t *counts, 
+		double per);
+
+void tap_perf_format(tap_line_t *out, const char *title, const double *vals,
+		int precision);
+
+#endif // TAP_PERF_H
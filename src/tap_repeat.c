@@ -0,0 +1,175 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "tap_capture.h"
+#include "tap_heap.h"
+#include "tap_main.h"
+#include "tap_repeat.h"
+#include "tap_round.h"
+#include "tap_sched.h"
+#include "tap.h"
+
+/** Quantile of the normal distribution for 95% confidence intervals */
+#define TAP_REPEAT_Z 1.96
+
+/** Repetitions of every round, 0 if rounds aren't repeated */
+unsigned int tap_repeat;
+
+/** Take the repetitions from TAP_FLAGS_REPEAT_* unless --repeat was used */
+void tap_repeat_init(void)
+{
+	if (tap_repeat) {
+		return;
+	}
+
+	if (tap_flags & TAP_FLAGS_REPEAT_120) {
+		tap_repeat = 120;
+	} else if (tap_flags & TAP_FLAGS_REPEAT_40) {
+		tap_repeat = 40;
+	} else if (tap_flags & TAP_FLAGS_REPEAT_10) {
+		tap_repeat = 10;
+	}
+}
+
+static int tap_repeat_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/** Quantile of Student's t-distribution for 95% intervals, approximated */
+static double tap_repeat_t(unsigned int df)
+{
+	return TAP_REPEAT_Z + 2.5 / df + 1.5 / ((double)df * df);
+}
+
+/** Compute the summary of repetitions from their durations */
+static void tap_repeat_stats(tap_repeat_stats_t *stats, double *ns)
+{
+	unsigned int i, n = stats->repetitions;
+	double p, z2 = TAP_REPEAT_Z * TAP_REPEAT_Z, center, half, var = 0;
+
+	qsort(ns, n, sizeof *ns, tap_repeat_cmp);
+
+	for (stats->mean = 0, i = 0; i < n; i++) {
+		stats->mean += ns[i] / n;
+	}
+	for (i = 0; i < n; i++) {
+		var += (ns[i] - stats->mean) * (ns[i] - stats->mean);
+	}
+
+	stats->min = ns[0];
+	stats->median = n % 2 ? ns[n / 2] : (ns[n / 2 - 1] + ns[n / 2]) / 2;
+	stats->p95 = ns[(n * 95 + 99) / 100 - 1];
+	stats->stddev = n > 1 ? sqrt(var / (n - 1)) : 0;
+
+	half = n > 1 ? tap_repeat_t(n - 1) * stats->stddev / sqrt(n) : 0;
+	stats->ci_low = stats->mean > half ? stats->mean - half : 0;
+	stats->ci_high = stats->mean + half;
+
+	/* The Wilson interval works for flake rates close to 0 too */
+	p = (double)stats->failures / n;
+	center = (p + z2 / (2 * n)) / (1 + z2 / n);
+	half = TAP_REPEAT_Z / (1 + z2 / n) * 
+			sqrt(p * (1 - p) / n + z2 / (4.0 * n * n));
+	stats->flake_low = center - half > 0 ? center - half : 0;
+	stats->flake_high = center + half < 1 ? center + half : 1;
+}
+
+/** Execute the round tap_repeat times and report one summarized test
+ * @param round - the round
+ * @param count - how many times tap_main() is called in a repetition
+ *
+ * Tests of repetitions are captured and dropped, a repetition failed, if
+ * any of its tests failed. The output of the first failed repetition is
+ * kept for the report.
+ */
+void tap_repeat_round(unsigned long round, int count)
+{
+	tap_capture_t *outer = tap_capture, capture, failed;
+	tap_repeat_stats_t stats = { .round = round };
+	unsigned long long start;
+	const char *data;
+	size_t pos, len;
+	tap_rec_t kind;
+	unsigned int i;
+	double *ns;
+	int j, fail;
+
+	tap_heap_ignore(1);
+	ns = malloc(tap_repeat * sizeof *ns);
+	tap_heap_ignore(0);
+	if (ns == NULL) {
+		BAIL_OUT("Out of memory");
+	}
+
+	tap_capture_init(&capture);
+	tap_capture_init(&failed);
+
+	/* Fast passes aren't captured */
+	__atomic_add_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+
+	for (i = 0; i < tap_repeat; i++) {
+		tap_capture = &capture;
+		start = tap_sched_now();
+		for (j = 0; j < count; j++) {
+			tap_main(round);
+		}
+		ns[i] = tap_sched_now() - start;
+		tap_capture = outer;
+
+		for (fail = 0, pos = 0; NULL != (data = tap_capture_next(
+				&capture, &pos, &kind, &len)); ) {
+			fail |= kind == TAP_REC_NOT_OK;
+		}
+
+		/* Records are copied by tap_capture_put(), which isn't 
+		   accounted to the heap usage of the round */
+		if (fail && stats.failures++ == 0) {
+			for (pos = 0; NULL != (data = tap_capture_next(
+					&capture, &pos, &kind, &len)); ) {
+				tap_capture_put(&failed, kind, data, len);
+			}
+		}
+		capture.buf.len = 0;
+	}
+
+	__atomic_sub_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+
+	stats.repetitions = tap_repeat;
+	tap_repeat_stats(&stats, ns);
+	tap_repeat_result(&stats, stats.failures ? &failed : NULL);
+
+	tap_capture_free(&capture);
+	tap_capture_free(&failed);
+	tap_heap_ignore(1);
+	free(ns);
+	tap_heap_ignore(0);
+}
@@ -0,0 +1,62 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_REPEAT_H
+#define TAP_REPEAT_H
+
+#include "tap_capture.h"
+
+/** Summary of repetitions of a round */
+typedef struct tap_repeat_stats_s {
+	unsigned long round;
+	unsigned int repetitions;
+	unsigned int failures;
+	/** 95% Wilson score interval of the flake rate */
+	double flake_low;
+	double flake_high;
+	/** Durations of repetitions in ns */
+	double min;
+	double median;
+	double mean;
+	double p95;
+	double stddev;
+	/** 95% confidence interval of the mean duration */
+	double ci_low;
+	double ci_high;
+} tap_repeat_stats_t;
+
+extern unsigned int tap_repeat;
+
+void tap_repeat_init(void);
+
+void tap_repeat_round(unsigned long round, int count);
+
+/* From tap.c */
+
+unsigned int tap_repeat_result(const tap_repeat_stats_t *stats, 
+		const tap_capture_t *failed);
+
+#endif // TAP_REPEAT_H
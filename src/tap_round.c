@@ -0,0 +1,156 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_history.h"
+#include "tap_main.h"
+#include "tap_round.h"
+#include "tap_sched.h"
+#include "tap.h"
+
+/** Number of the slowest rounds reported at the end, 0 if disabled */
+unsigned int tap_round_slowest;
+
+/** When the library was initialized */
+static unsigned long long tap_round_epoch;
+
+/** When the last test of the thread finished or its round started */
+static __thread unsigned long long tap_round_last;
+
+/** Round executed by the thread, -1 if it isn't executing any */
+__thread long tap_round_current = -1;
+
+/** The slowest rounds, the slowest one first */
+static struct tap_round_s {
+	unsigned long round;
+	unsigned long long ns;
+} *tap_round_top;
+
+static unsigned int tap_round_count;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t tap_round_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void tap_round_init(void)
+{
+	tap_round_epoch = tap_sched_now();
+
+	if (tap_round_slowest) {
+		tap_round_top = calloc(tap_round_slowest, sizeof *tap_round_top);
+		if (tap_round_top == NULL) {
+			tap_round_slowest = 0;
+		}
+	}
+}
+
+/** Measure durations of tests of the thread from now */
+void tap_round_start(unsigned long round)
+{
+	tap_round_current = round;
+	tap_round_last = tap_sched_now();
+}
+
+/** Duration of the test, which just finished, and the time since start
+ *
+ * The duration of a test is the time since the previous test of the thread
+ * or since the start of its round.
+ */
+void tap_round_timing(unsigned long long *duration, 
+		unsigned long long *since_start)
+{
+	unsigned long long now = tap_sched_now();
+
+	*duration = now - (tap_round_last ? tap_round_last : tap_round_epoch);
+	*since_start = now - tap_round_epoch;
+	tap_round_last = now;
+}
+
+/** Account the duration of the round for the slowest rounds report 
+ *
+ * The duration is appended to the history too, if rounds are timed.
+ */
+void tap_round_done(unsigned long round, unsigned long long ns)
+{
+	tap_history_rec_t rec;
+	unsigned int i;
+
+	if (tap_round_slowest || (tap_flags & TAP_FLAGS_TIMING)) {
+		memset(&rec, 0, sizeof rec);
+		rec.kind = TAP_HISTORY_ROUND;
+		rec.round = round;
+		rec.samples = 1;
+		rec.iterations = 1;
+		rec.min = rec.median = rec.mean = rec.p99 = ns;
+		tap_history_store(&rec);
+	}
+
+	if (tap_round_slowest == 0) {
+		return;
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&tap_round_lock);
+#endif
+	if (tap_round_count < tap_round_slowest || 
+	    ns > tap_round_top[tap_round_count - 1].ns) {
+		if (tap_round_count < tap_round_slowest) {
+			tap_round_count++;
+		}
+		for (i = tap_round_count - 1; 
+				i > 0 && tap_round_top[i - 1].ns < ns; i--) {
+			tap_round_top[i] = tap_round_top[i - 1];
+		}
+		tap_round_top[i].round = round;
+		tap_round_top[i].ns = ns;
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&tap_round_lock);
+#endif
+}
+
+/** Print the table of the slowest rounds */
+void tap_round_report(void)
+{
+	unsigned int i;
+
+	if (tap_round_count == 0) {
+		return;
+	}
+
+	diag("Slowest rounds:");
+	diag("    %8s %14s", "round", "duration [ms]");
+	for (i = 0; i < tap_round_count; i++) {
+		diag("    %8lu %14.3f", tap_round_top[i].round, 
+				tap_round_top[i].ns / 1e6);
+	}
+}
@@ -0,0 +1,283 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "tap_main.h"
+#include "tap_rusage.h"
+#include "tap.h"
+
+/** Getrusage of the calling thread, if the system knows it */
+#ifdef RUSAGE_THREAD
+#define TAP_RUSAGE_WHO RUSAGE_THREAD
+#define TAP_RUSAGE_IO "/proc/thread-self/io"
+#define TAP_RUSAGE_IO_THREAD 1
+#else
+#define TAP_RUSAGE_WHO RUSAGE_SELF
+#define TAP_RUSAGE_IO "/proc/self/io"
+#define TAP_RUSAGE_IO_THREAD 0
+#endif
+
+/** Usage at the start of the round of the thread, zero outside of rounds */
+static __thread tap_rusage_t tap_rusage_round;
+
+/** Usage at the end of the last test of the thread */
+static __thread tap_rusage_t tap_rusage_last;
+
+/** Bytes of the io file read by the thread */
+static __thread unsigned long long tap_rusage_own;
+
+/** Bytes of the io file read by the process */
+static unsigned long long tap_rusage_own_all;
+
+/** True, if the usage is reported by tests and rounds */
+static int tap_rusage_reporting(void)
+{
+	return tap_verbose || (tap_flags & TAP_FLAGS_RUSAGE);
+}
+
+/** Read rchar and wchar of the thread, or of the process if the system
+ *  doesn't count threads
+ * @return 0 on success
+ */
+static int tap_rusage_io(tap_rusage_t *usage)
+{
+	int thread = TAP_RUSAGE_IO_THREAD;
+	char buf[512], *c;
+	ssize_t len;
+	int fd;
+
+	fd = open(TAP_RUSAGE_IO, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return -1;
+		}
+		thread = 0;
+	}
+	len = read(fd, buf, sizeof buf - 1);
+	close(fd);
+	if (len <= 0) {
+		return -1;
+	}
+	buf[len] = '\0';
+
+	c = strstr(buf, "rchar:");
+	if (c == NULL || 1 != sscanf(c, "rchar: %llu", &usage->rchar)) {
+		return -1;
+	}
+	c = strstr(buf, "wchar:");
+	if (c == NULL || 1 != sscanf(c, "wchar: %llu", &usage->wchar)) {
+		return -1;
+	}
+
+	/* Reads of the file itself and the TAP output aren't counted in 
+	   deltas, the process-wide file needs process-wide corrections */
+	if (thread) {
+		usage->rchar -= tap_rusage_own;
+		usage->wchar -= tap_output_thread_written;
+	} else {
+		usage->rchar -= __atomic_load_n(&tap_rusage_own_all, 
+				__ATOMIC_RELAXED);
+		usage->wchar -= __atomic_load_n(&tap_output_written, 
+				__ATOMIC_RELAXED);
+	}
+	tap_rusage_own += len;
+	__atomic_add_fetch(&tap_rusage_own_all, len, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+/** Read the usage of the thread
+ * @param io - true, if /proc/self/io should be read too
+ */
+void tap_rusage_read(tap_rusage_t *usage, int io)
+{
+	struct rusage ru;
+
+	memset(usage, 0, sizeof *usage);
+	if (getrusage(TAP_RUSAGE_WHO, &ru)) {
+		return;
+	}
+
+	usage->user_us = ru.ru_utime.tv_sec * 1000000ULL + ru.ru_utime.tv_usec;
+	usage->sys_us = ru.ru_stime.tv_sec * 1000000ULL + ru.ru_stime.tv_usec;
+	usage->minflt = ru.ru_minflt;
+	usage->majflt = ru.ru_majflt;
+	usage->nvcsw = ru.ru_nvcsw;
+	usage->nivcsw = ru.ru_nivcsw;
+	usage->maxrss = ru.ru_maxrss;
+
+	usage->io = io && tap_rusage_io(usage) == 0;
+}
+
+/** Difference of usages, the peak RSS is taken from the end */
+void tap_rusage_delta(tap_rusage_t *delta, const tap_rusage_t *start, 
+		const tap_rusage_t *end)
+{
+	delta->user_us = end->user_us - start->user_us;
+	delta->sys_us = end->sys_us - start->sys_us;
+	delta->minflt = end->minflt - start->minflt;
+	delta->majflt = end->majflt - start->majflt;
+	delta->nvcsw = end->nvcsw - start->nvcsw;
+	delta->nivcsw = end->nivcsw - start->nivcsw;
+	delta->maxrss = end->maxrss;
+	delta->io = start->io && end->io;
+	delta->rchar = end->rchar - start->rchar;
+	delta->wchar = end->wchar - start->wchar;
+}
+
+/** Measure the usage of the round from now */
+void tap_rusage_round_start(void)
+{
+	tap_rusage_read(&tap_rusage_round, tap_rusage_reporting());
+	tap_rusage_last = tap_rusage_round;
+}
+
+/** Print the usage of the round, which just finished, with --rusage or -v */
+void tap_rusage_round_done(unsigned long round)
+{
+	tap_rusage_t now, delta;
+	tap_line_t line;
+
+	if (!tap_rusage_reporting()) {
+		return;
+	}
+
+	tap_rusage_read(&now, 1);
+	tap_rusage_delta(&delta, &tap_rusage_round, &now);
+
+	tap_line_init(&line);
+	tap_line_printf(&line, "Round %lu: user %.3f ms, sys %.3f ms, "
+			"faults %ld minor %ld major, context switches %ld "
+			"voluntary %ld involuntary, max RSS %ld kB", round, 
+			delta.user_us / 1000.0, delta.sys_us / 1000.0, 
+			delta.minflt, delta.majflt, delta.nvcsw, delta.nivcsw, 
+			delta.maxrss);
+	if (delta.io) {
+		tap_line_printf(&line, ", read %llu B, written %llu B", 
+				delta.rchar, delta.wchar);
+	}
+	diag("%s", line.buf);
+	tap_line_free(&line);
+}
+
+/** Usage of the test, which just finished, since the previous test of the
+ *  thread or since the start of its round */
+void tap_rusage_test(tap_rusage_t *delta)
+{
+	tap_rusage_t now;
+
+	tap_rusage_read(&now, 1);
+	tap_rusage_delta(delta, &tap_rusage_last, &now);
+	tap_rusage_last = now;
+}
+
+/** Append the usage as a YAMLish map */
+void tap_rusage_format(tap_line_t *out, const tap_rusage_t *delta)
+{
+	tap_line_puts(out, "  rusage:\n");
+	tap_line_printf(out, "    user_us: %llu\n", delta->user_us);
+	tap_line_printf(out, "    sys_us: %llu\n", delta->sys_us);
+	tap_line_printf(out, "    minor_faults: %ld\n", delta->minflt);
+	tap_line_printf(out, "    major_faults: %ld\n", delta->majflt);
+	tap_line_printf(out, "    voluntary_ctx_switches: %ld\n", 
+			delta->nvcsw);
+	tap_line_printf(out, "    involuntary_ctx_switches: %ld\n", 
+			delta->nivcsw);
+	tap_line_printf(out, "    max_rss_kb: %ld\n", delta->maxrss);
+	if (delta->io) {
+		tap_line_printf(out, "    read_bytes: %llu\n", delta->rchar);
+		tap_line_printf(out, "    written_bytes: %llu\n", delta->wchar);
+	}
+}
+
+/** Usage of the thread since the start of its round */
+static void tap_rusage_since_round(tap_rusage_t *delta)
+{
+	tap_rusage_t now;
+
+	tap_rusage_read(&now, 0);
+	tap_rusage_delta(delta, &tap_rusage_round, &now);
+}
+
+int ok_max_faults_f(unsigned long max, const char *func, const char *file, 
+		unsigned int line, const char *fmt, ...)
+{
+	tap_rusage_t delta;
+	tap_line_t name;
+	va_list ap;
+	int rtn;
+
+	tap_rusage_since_round(&delta);
+
+	tap_line_init(&name);
+	if (*fmt) {
+		va_start(ap, fmt);
+		tap_line_vprintf(&name, fmt, ap);
+		va_end(ap);
+	} else {
+		tap_line_printf(&name, "At most %lu page faults", max);
+	}
+
+	rtn = tap_max_result(delta.minflt + delta.majflt, max, func, file, 
+			line, "%s", name.buf);
+	tap_line_free(&name);
+
+	return rtn;
+}
+
+int ok_max_ctx_switches_f(unsigned long max, const char *func, 
+		const char *file, unsigned int line, const char *fmt, ...)
+{
+	tap_rusage_t delta;
+	tap_line_t name;
+	va_list ap;
+	int rtn;
+
+	tap_rusage_since_round(&delta);
+
+	tap_line_init(&name);
+	if (*fmt) {
+		va_start(ap, fmt);
+		tap_line_vprintf(&name, fmt, ap);
+		va_end(ap);
+	} else {
+		tap_line_printf(&name, "At most %lu context switches", max);
+	}
+
+	rtn = tap_max_result(delta.nvcsw + delta.nivcsw, max, func, file, 
+			line, "%s", name.buf);
+	tap_line_free(&name);
+
+	return rtn;
+}
@@ -0,0 +1,66 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TAP_RUSAGE_H
+#define TAP_RUSAGE_H
+
+#include "tap_output.h"
+
+/** Resource usage of a thread, see getrusage() and /proc/self/io */
+typedef struct tap_rusage_s {
+	unsigned long long user_us;
+	unsigned long long sys_us;
+	long minflt;
+	long majflt;
+	long nvcsw;
+	long nivcsw;
+	/** Peak resident set size of the process in kB, it isn't a delta */
+	long maxrss;
+	/** Bytes read and written by syscalls (rchar, wchar) */
+	unsigned long long rchar;
+	unsigned long long wchar;
+	/** True, if rchar and wchar are valid */
+	int io;
+} tap_rusage_t;
+
+void tap_rusage_read(tap_rusage_t *usage, int io);
+
+void tap_rusage_delta(tap_rusage_t *delta, const tap_rusage_t *start, 
+		const tap_rusage_t *end);
+
+void tap_rusage_round_start(void);
+
+void tap_rusage_round_done(unsigned long round);
+
+void tap_rusage_test(tap_rusage_t *delta);
+
+void tap_rusage_format(tap_line_t *out, const tap_rusage_t *delta);
+
+unsigned int tap_max_result(unsigned long long got, unsigned long long max,
+		const char *func, const char *file, unsigned int line, 
+		const char *fmt, ...);
+
+#endif // TAP_RUSAGE_H
@@ -0,0 +1,346 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif // HAVE_LIBPTHREAD
+
+#include "tap_main.h"
+#include "tap_params.h"
+#include "tap_sched.h"
+#include "tap.h"
+
+/** Rounds queued for one worker, it takes them from the head and idle
+ *  workers steal them from the tail */
+struct tap_sched_queue_s {
+	unsigned long *rounds;
+	unsigned long head;
+	unsigned long tail;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t lock;
+#endif
+};
+
+/** Scheduler of parameter rounds */
+struct tap_sched_s {
+	int workers;
+	unsigned long nmemb;
+	/** File with durations of rounds or NULL */
+	const char *timings;
+	/** Durations of rounds in previous runs, 0 if unknown */
+	unsigned long long *history;
+	/** Durations of rounds in this run, 0 if it wasn't run */
+	unsigned long long *duration;
+	/** When the scheduler was created */
+	unsigned long long start;
+	struct tap_sched_queue_s queues[];
+};
+
+/** Round and its expected duration */
+struct tap_sched_order_s {
+	unsigned long long ns;
+	unsigned long round;
+};
+
+static void tap_sched_lock(struct tap_sched_queue_s *queue)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&queue->lock);
+#endif
+}
+
+static void tap_sched_unlock(struct tap_sched_queue_s *queue)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&queue->lock);
+#endif
+}
+
+/** Monotonic time in nanoseconds */
+unsigned long long tap_sched_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** Read durations of rounds, the file is ignored if it's for other rounds */
+static void tap_sched_load(tap_sched_t *sched)
+{
+	unsigned long nmemb, round;
+	unsigned long long ns;
+	FILE *f;
+
+	f = fopen(sched->timings, "r");
+	if (f == NULL) {
+		return;
+	}
+
+	if (1 == fscanf(f, "rounds %lu\n", &nmemb) && nmemb == sched->nmemb) {
+		while (2 == fscanf(f, "%lu %llu\n", &round, &ns)) {
+			if (round < nmemb) {
+				sched->history[round] = ns;
+			}
+		}
+	}
+
+	fclose(f);
+}
+
+/** Write durations of rounds, rounds not run keep their old durations */
+static void tap_sched_save(tap_sched_t *sched)
+{
+	unsigned long long ns;
+	unsigned long i;
+	char *tmp;
+	FILE *f;
+
+	tmp = malloc(strlen(sched->timings) + sizeof ".tmp");
+	if (tmp == NULL) {
+		return;
+	}
+	sprintf(tmp, "%s.tmp", sched->timings);
+
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		free(tmp);
+		return;
+	}
+
+	fprintf(f, "rounds %lu\n", sched->nmemb);
+	for (i = 0; i < sched->nmemb; i++) {
+		ns = sched->duration[i] ? sched->duration[i] : sched->history[i];
+		if (ns) {
+			fprintf(f, "%lu %llu\n", i, ns);
+		}
+	}
+
+	if (fclose(f) == 0) {
+		rename(tmp, sched->timings);
+	} else {
+		unlink(tmp);
+	}
+
+	free(tmp);
+}
+
+/** Longer rounds go first, the order of rounds is kept otherwise */
+static int tap_sched_cmp(const void *a, const void *b)
+{
+	const struct tap_sched_order_s *x = a, *y = b;
+
+	if (x->ns != y->ns) {
+		return x->ns < y->ns ? 1 : -1;
+	}
+
+	return x->round < y->round ? -1 : x->round > y->round;
+}
+
+/** Create a scheduler of rounds, which are not skipped
+ * @param skip - bitset of skipped rounds, see TAP_PARAMS_SKIPPED
+ * @param vals_nmemb - number of rounds
+ * @param workers - number of workers taking rounds
+ * @param timings - file with durations of rounds from previous runs or NULL
+ *
+ * Rounds are ordered longest first and dealt to workers one by one, so every
+ * worker starts with its longest round. Without the history rounds are dealt
+ * in their order.
+ */
+tap_sched_t *tap_sched_create(const unsigned long *skip, 
+		unsigned long vals_nmemb, int workers, const char *timings)
+{
+	struct tap_sched_order_s *order;
+	struct tap_sched_queue_s *queue;
+	unsigned long long known_ns = 0;
+	unsigned long i, n = 0, known = 0;
+	tap_sched_t *sched;
+	int w;
+
+	sched = calloc(1, sizeof *sched + workers * sizeof sched->queues[0]);
+	order = calloc(vals_nmemb + 1, sizeof *order);
+	if (sched) {
+		sched->history = calloc(vals_nmemb + 1, sizeof *sched->history);
+		sched->duration = calloc(vals_nmemb + 1, sizeof *sched->duration);
+	}
+	if (!sched || !order || !sched->history || !sched->duration) {
+		BAIL_OUT("Out of memory");
+	}
+
+	sched->workers = workers;
+	sched->nmemb = vals_nmemb;
+	sched->timings = timings;
+
+	for (w = 0; w < workers; w++) {
+		queue = sched->queues + w;
+		queue->rounds = calloc(vals_nmemb / workers + 1, 
+				sizeof *queue->rounds);
+		if (queue->rounds == NULL) {
+			BAIL_OUT("Out of memory");
+		}
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_init(&queue->lock, NULL);
+#endif
+	}
+
+	if (timings) {
+		tap_sched_load(sched);
+	}
+
+	for (i = 0; i < vals_nmemb; i++) {
+		if (TAP_PARAMS_SKIPPED(skip, i)) {
+			continue;
+		}
+
+		order[n].round = i;
+		order[n].ns = sched->history[i];
+		if (order[n++].ns) {
+			known_ns += sched->history[i];
+			known++;
+		}
+	}
+
+	/* Rounds run for the first time are expected to take average time */
+	if (known) {
+		for (i = 0; i < n; i++) {
+			if (order[i].ns == 0) {
+				order[i].ns = known_ns / known;
+			}
+		}
+		qsort(order, n, sizeof *order, tap_sched_cmp);
+	}
+
+	for (i = 0; i < n; i++) {
+		queue = sched->queues + i % workers;
+		queue->rounds[queue->tail++] = order[i].round;
+	}
+
+	free(order);
+
+	sched->start = tap_sched_now();
+
+	return sched;
+}
+
+/** Get the next round for the worker
+ *
+ * If the worker doesn't have any rounds queued, it steals the shortest one
+ * from the worker with the most rounds queued.
+ *
+ * @return the round or -1 if there are no rounds left
+ */
+long tap_sched_next(tap_sched_t *sched, int worker)
+{
+	struct tap_sched_queue_s *queue = sched->queues + worker;
+	struct tap_sched_queue_s *victim;
+	unsigned long queued, most;
+	long round = -1;
+	int w;
+
+	tap_sched_lock(queue);
+	if (queue->head < queue->tail) {
+		round = queue->rounds[queue->head++];
+	}
+	tap_sched_unlock(queue);
+
+	while (round < 0) {
+		victim = NULL;
+		most = 0;
+
+		for (w = 0; w < sched->workers; w++) {
+			queue = sched->queues + w;
+			queued = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED) -
+				__atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+			if ((long)queued > (long)most) {
+				victim = queue;
+				most = queued;
+			}
+		}
+
+		if (victim == NULL) {
+			break;
+		}
+
+		tap_sched_lock(victim);
+		if (victim->head < victim->tail) {
+			round = victim->rounds[--victim->tail];
+		}
+		tap_sched_unlock(victim);
+	}
+
+	return round;
+}
+
+/** Note the duration of a finished round */
+void tap_sched_done(tap_sched_t *sched, unsigned long round, 
+		unsigned long long ns)
+{
+	sched->duration[round] = ns ? ns : 1;
+}
+
+/** Report the parallel efficiency with -v or --timing, save durations of
+ *  rounds and free the scheduler */
+void tap_sched_finish(tap_sched_t *sched)
+{
+	unsigned long long wall = tap_sched_now() - sched->start;
+	unsigned long long busy = 0;
+	unsigned long i;
+	int w;
+
+	for (i = 0; i < sched->nmemb; i++) {
+		busy += sched->duration[i];
+	}
+
+	if (sched->workers > 1 && wall && 
+	    (tap_verbose || (tap_flags & TAP_FLAGS_TIMING))) {
+		diag("Parallel efficiency %.1f%% (%d workers busy %.3f s of "
+				"%.3f s)", 100.0 * busy / wall / sched->workers,
+				sched->workers, busy / 1e9, 
+				wall * sched->workers / 1e9);
+	}
+
+	if (sched->timings) {
+		tap_sched_save(sched);
+	}
+
+	for (w = 0; w < sched->workers; w++) {
+		free(sched->queues[w].rounds);
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_destroy(&sched->queues[w].lock);
+#endif
+	}
+
+	free(sched->duration);
+	free(sched->history);
+	free(sched);
+}
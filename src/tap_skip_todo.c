@@ -29,6 +29,7 @@
 #include <stdio.h>
 
 #include "tap_skip_todo.h"
+#include "tap_arena.h"
 #include "tap.h"
 
 /* SKIPB functionality */
@@ -79,7 +80,7 @@ static inline void tap_skip_set(tap_skip_t *ptr)
 
 void tap_skip_start(void)
 {
-	tap_skip_t *new = malloc(sizeof *new);
+	tap_skip_t *new = tap_arena_alloc(sizeof *new);
 
 	new->prev = tap_skip_get();
 	new->cond_evals = 0;
@@ -99,7 +100,7 @@ int tap_skip_cond(void)
 	}
 
 	tap_skip_set(current->prev);
-	free(current);
+	tap_arena_free(current);
 
 	return 0;
 }
@@ -108,7 +109,7 @@ int tap_skip_cond(void)
 
 typedef struct tap_todo_s {
 	struct tap_todo_s *prev;
-	const char *msg;
+	char *msg;
 	int cond_evals;
 } tap_todo_t;
 
@@ -151,16 +152,14 @@ static inline void tap_todo_set(tap_todo_t *ptr)
 
 void tap_todo_start(const char *fmt, ...)
 {
-	tap_todo_t *new = malloc(sizeof *new);
+	tap_todo_t *new = tap_arena_alloc(sizeof *new);
 
 	new->prev = tap_todo_get();
 
 	if (fmt) {
 		va_list ap;
 		va_start(ap, fmt);
-		if (vasprintf(&new->msg, fmt, ap) < 0) {
-			new->msg = NULL;
-		}
+		new->msg = tap_arena_vprintf(fmt, ap);
 		va_end(ap);
 	} else {
 		new->msg = NULL;
@@ -168,6 +167,9 @@ void tap_todo_start(const char *fmt, ...)
 
 	new->cond_evals = 0;
 	tap_todo_set(new);
+
+	/* Passing TODO tests must be reported as such */
+	__atomic_add_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
 }
 
 int tap_todo_cond(void)
@@ -182,8 +184,9 @@ int tap_todo_cond(void)
 	}
 
 	tap_todo_set(current->prev);
-	free(current->msg);
-	free(current);
+	__atomic_sub_fetch(&tap_fast_inhibit, 1, __ATOMIC_RELAXED);
+	tap_arena_free(current->msg);
+	tap_arena_free(current);
 
 	return 0;
 }
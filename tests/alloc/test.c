@@ -0,0 +1,91 @@
+/*-
+ * Copyright (c) 2004 Nik Clayton
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tap.h"
+
+/* Count heap allocations done by the process. Relies on the glibc internal
+   allocator entry points */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocs = 0;
+
+void *malloc(size_t size)
+{
+	allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocs++;
+	return __libc_realloc(ptr, size);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long before, after;
+	int i;
+
+	plan_tests(11);
+
+	before = allocs;
+	ok(1, "passing test without arguments");
+	ok(1 == 1);
+	ok(1, "passing test number %d with %s", 3, "arguments");
+	is(5, 5, "passing is()");
+	TODO("not yet %s", "done") {
+		ok(1, "passing TODO test");
+	}
+	SKIP(1, 1, "skipped for %s reason", "no") {
+		ok(1, "not executed");
+	}
+	after = allocs;
+
+	ok(before == after, "no allocations were done");
+
+	before = allocs;
+	for (i = 0; i < 3; i++) {
+		ok(1, "passing test %d in a loop", i);
+	}
+	after = allocs;
+
+	ok(before == after, "no allocations in a loop");
+
+	return exit_status();
+}
@@ -0,0 +1,28 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 11;
+
+ok(1, 'passing test without arguments');
+ok(1, '1 == 1');
+ok(1, 'passing test number 3 with arguments');
+is(5, 5, 'passing is()');
+TODO: {
+	local $TODO = 'not yet done';
+	ok(1, 'passing TODO test');
+}
+SKIP: {
+	skip 'skipped for no reason', 1;
+}
+
+ok(1, 'no allocations were done');
+
+for (my $i = 0; $i < 3; $i++) {
+	ok(1, "passing test $i in a loop");
+}
+
+ok(1, 'no allocations in a loop');
@@ -0,0 +1,56 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "tap.h"
+
+/* Results of benchmarks are recorded, checked against and updated in the
+   baseline file given by test.t, the tolerance is huge as the test checks
+   the bookkeeping and not the speed */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(size, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 2, .size = 1024),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .size = 4096),
+)
+
+void tap_main(int round)
+{
+	char src[4096], dst[4096];
+
+	memset(src, round, sizeof src);
+
+	TAP_BENCH("copy of %d bytes", TAP_PARAM(size)) {
+		memcpy(dst, src, TAP_PARAM(size));
+		tap_bench_clobber();
+	}
+
+	ok_faster_than_baseline("copy", 10);
+}
@@ -0,0 +1,37 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+# The mode of ok_faster_than_baseline is the argument, 'none' when the
+# baseline file doesn't exist
+my $mode = shift;
+
+plan tests => 4;
+
+my $out = Test::More->builder->output;
+
+for my $size (1024, 4096) {
+	ok(1, "copy of $size bytes");
+	print $out <<END;
+  ---
+  name: copy of $size bytes
+  line: 50
+  samples: 9
+  ...
+END
+
+	if ($mode eq 'record' or $mode eq 'update') {
+		SKIP: {
+			skip("Baseline of copy stored", 1);
+		}
+	} elsif ($mode eq 'none') {
+		SKIP: {
+			skip("No baseline of copy", 1);
+		}
+	} else {
+		ok(1, "copy is not slower than its baseline");
+	}
+}
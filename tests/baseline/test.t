@@ -0,0 +1,73 @@
+#!/bin/sh
+
+echo '1..9'
+
+# Runs the test in the given mode and compares its output with perl
+run()
+{
+	perl $srcdir/test.pl $1 2> /dev/null > test.pl.out
+	./test --bench-samples 9 --bench-time 100 --baseline test.baseline \
+		--baseline-mode $2 2> test.c.err > test.c.raw
+	cstatus=$?
+
+	# Durations and iterations of samples differ from run to run, the
+	# path of the source depends on the build directory
+	grep -v "^  [a-z0-9]*_ns: \|^  iterations: \|^  file: " test.c.raw \
+		> test.c.out
+
+	diff -u test.pl.out test.c.out && [ $cstatus -eq 0 ]
+}
+
+# Prints ok or not ok with the given description by the last status
+result()
+{
+	if [ $? -eq 0 ]; then
+		echo "ok $1"
+	else
+		retval=1
+		echo "not ok $1"
+	fi
+}
+
+rm -f test.baseline
+
+run none check
+result '1 - missing baseline skips the test'
+
+# A baseline of another test is dropped by the record mode
+echo '5 1.000 0.000 1 other' > test.baseline
+run record record
+result '2 - record mode stores the baseline'
+
+[ $(grep -c '^[01] [0-9.]* [0-9.]* 9 copy$' test.baseline) -eq 2 ] &&
+	[ $(grep -c . test.baseline) -eq 3 ]
+result '3 - baseline of each round is recorded'
+
+run check check
+result '4 - recorded baseline is checked'
+
+# The first round is much faster in the edited baseline
+sed -i 's/^0 [0-9.]* [0-9.]*/0 0.001 0.000/' test.baseline
+run check check > /dev/null
+[ $cstatus -eq 1 ] && grep -q '^not ok 2 - copy is not slower' test.c.raw &&
+	grep -q 'copy is slower than its baseline' test.c.err
+result '5 - slower result fails'
+
+run check warn && grep -q 'copy is slower than its baseline' test.c.err
+result '6 - slower result only warns in the warn mode'
+
+echo '5 1.000 0.000 1 other' >> test.baseline
+run update update
+result '7 - update mode stores the baseline'
+
+# Older results are compacted away, other tests are kept
+[ $(grep -c '^[01] [0-9.]* [0-9.]* 9 copy$' test.baseline) -eq 2 ] &&
+	! grep -q '^0 0.001 ' test.baseline &&
+	grep -q '^5 1.000 0.000 1 other$' test.baseline &&
+	[ $(grep -c . test.baseline) -eq 4 ]
+result '8 - updated baseline is compacted'
+
+run check check
+result '9 - updated baseline is checked'
+
+exit $retval
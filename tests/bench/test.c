@@ -0,0 +1,58 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "tap.h"
+
+/* Every TAP_BENCH is reported by one passed test with statistics of its
+   samples, durations differ from run to run and they are filtered out */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(size, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 2, .size = 16),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .size = 64),
+)
+
+void tap_main(int round)
+{
+	char src[64], dst[64];
+	unsigned long runs = 0;
+
+	memset(src, round, sizeof src);
+
+	TAP_BENCH("copy of %d bytes", TAP_PARAM(size)) {
+		memcpy(dst, src, TAP_PARAM(size));
+		tap_bench_clobber();
+		runs++;
+	}
+
+	/* The calibration runs the block at least once more */
+	ok(runs > 5, "block of round %d was run for every sample", round);
+}
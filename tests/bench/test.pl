@@ -0,0 +1,25 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 4;
+
+my $out = Test::More->builder->output;
+
+for my $size (16, 64) {
+	my $round = $size == 16 ? 0 : 1;
+
+	ok(1, "copy of $size bytes");
+	print $out <<END;
+  ---
+  name: copy of $size bytes
+  line: 50
+  samples: 5
+  ...
+END
+
+	ok(1, "block of round $round was run for every sample");
+}
@@ -0,0 +1,24 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+my $rc = 0;
+
+$rc = plan tests => 2003;
+diag("Returned: " . sprintf('%d', $rc));
+
+$rc = ok(1 == 1, 'first test # with a hash');
+diag("Returned: $rc");
+
+for (my $i = 0; $i < 2000; $i++) {
+	ok($i >= 0, "test number $i of a long run");
+}
+
+$rc = ok(1 == 2, 'failing test');
+diag("Returned: $rc");
+
+$rc = ok(1 == 1, 'last test');
+diag("Returned: $rc");
@@ -0,0 +1,16 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+ok(1, 'tests 1..1000 passed');
+ok(1 == 2, 'failing test');
+ok(1, 'test 1002 passed');
+SKIP: {
+	skip 'skipped test', 1;
+}
+ok(1, 'tests 1004..1005 passed');
+
+done_testing();
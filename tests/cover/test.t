@@ -0,0 +1,49 @@
+#!/bin/sh
+
+echo '1..4'
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+perlstatus=$?
+
+./test --cover 2 --seed 1 2> test.c.err > test.c.out
+cstatus=$?
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ]; then
+	echo 'ok 1 - output is identical'
+else
+	retval=1
+	echo 'not ok 1 - output is identical'
+fi
+
+if [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 2 - status code'
+else
+	retval=1
+	echo 'not ok 2 - status code'
+	echo "# perlstatus = $perlstatus"
+	echo "#    cstatus = $cstatus"
+fi
+
+# The report lists the selected rounds
+if grep -q '^#   round 9 (size: 16, threads: 2, random: 1)$' test.c.err; then
+	echo 'ok 3 - selected rounds are reported'
+else
+	retval=1
+	echo 'not ok 3 - selected rounds are reported'
+fi
+
+# Rounds skipped by -r aren't selected, tuples only they have are reported
+./test --cover 2 --seed 1 -r 0-11 > test.r.out 2>&1
+if [ "`grep -c '^ok ' test.r.out`" = 6 ] && \
+   grep -q '^# 10 tuples aren.t covered' test.r.out && \
+   grep -q '^#   size: 4096, random: 1$' test.r.out && \
+   ! grep '^ok ' test.r.out | grep -qv 'round \([0-9]\|1[01]\)$'; then
+	echo 'ok 4 - skipped rounds are not selected'
+else
+	retval=1
+	echo 'not ok 4 - skipped rounds are not selected'
+fi
+
+exit $retval
@@ -0,0 +1,52 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "tap.h"
+
+/* Rounds are read from the file given by -d, values missing in the file
+   are taken from the values array. The parameters use the struct body
+   syntax of TAP_PARAMS_DEFINITION, which is parsed at the start */
+
+TAP_PARAMS_DEFINITION(
+	int size;
+	const char *name;
+	char letter;
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 1, .size = -1, .letter = 'x'),
+)
+
+void tap_main(int round)
+{
+	ok(TAP_PARAM(letter) == 'x', "letter of round %d", round);
+	if (TAP_PARAM(size) > 0) {
+		ok(strlen(TAP_PARAM(name)) == TAP_PARAM(size), "%s", 
+				TAP_PARAM(name));
+	}
+}
@@ -0,0 +1,14 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 5;
+
+ok(1, "letter of round 0");
+ok(1, "letter of round 2");
+ok(1, 'a, "b"');
+ok(1, "letter of round 3");
+ok(1, "skipped");
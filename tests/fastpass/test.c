@@ -0,0 +1,88 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+
+#include "tap.h"
+
+/* Passed tests are reported without their names by the next test, which
+   takes the full path, or at exit. They keep their numbers when they are
+   mixed with failures, diagnostics, TODO blocks and passes of threads */
+
+#define THREADS 4
+
+static void *passes(void *arg)
+{
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		ok(i >= 0, "pass %d of a thread", i);
+	}
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	pthread_t threads[THREADS];
+	int i;
+
+	tap_init(TAP_FLAGS_FAST_PASS);
+
+	plan_tests(13 + THREADS * 100 + 8);
+
+	ok(1 == 1, "first test");
+	pass("second test");
+
+	ok(1 == 2, "failing test");
+
+	for (i = 0; i < 10; i++) {
+		ok(i >= 0, "test number %d of a run", i);
+	}
+	diag("Passed a run");
+
+	TODO ("not implemented") {
+		ok(1 == 1, "passing test in a TODO block");
+		ok(1 == 2, "failing test in a TODO block");
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		pthread_create(threads + i, NULL, passes, NULL);
+	}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	ok(1 == 2, "failing test after threads");
+
+	/* Reported at exit */
+	for (i = 0; i < 5; i++) {
+		pass("last tests");
+	}
+
+	return exit_status();
+}
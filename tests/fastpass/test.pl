@@ -0,0 +1,37 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 421;
+
+# libtap writes diagnostics of TODO tests to stderr too
+Test::More->builder->todo_output(\*STDERR);
+
+ok(1 == 1);
+pass();
+
+ok(1 == 2, 'failing test');
+
+for (my $i = 0; $i < 10; $i++) {
+	ok($i >= 0);
+}
+diag('Passed a run');
+
+TODO: {
+	local $TODO = 'not implemented';
+	ok(1 == 1, 'passing test in a TODO block');
+	ok(1 == 2, 'failing test in a TODO block');
+}
+
+for (my $i = 0; $i < 400; $i++) {
+	ok($i >= 0);
+}
+
+ok(1 == 2, 'failing test after threads');
+
+for (my $i = 0; $i < 5; $i++) {
+	pass();
+}
@@ -0,0 +1,68 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+
+/* Heap usage of rounds is tracked by libtap-alloc, the round which doesn't
+   free its buffer is reported as leaking. Rounds with the largest peak are
+   listed at the end. With -p fails=N the round fails N tests, captures of
+   failed repetitions (--repeat) mustn't be reported as leaks. */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(size, int)
+	TAP_PARAM_FIELD(leak, int)
+	TAP_PARAM_FIELD(fails, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 1, .size = 100),
+	TAP_PARAMS_VALUES(.tap.plan = 1, .size = 1000, .leak = 1),
+	TAP_PARAMS_VALUES(.tap.plan = 1, .size = 10000),
+)
+
+void tap_main(int round)
+{
+	char *buf, *tmp;
+	int i;
+
+	/* The peak is reached while both buffers are allocated */
+	buf = malloc(TAP_PARAM(size));
+	tmp = malloc(TAP_PARAM(size));
+	ok(buf && tmp, "round %d allocated %d B twice", round, 
+			TAP_PARAM(size));
+	free(tmp);
+
+	if (!TAP_PARAM(leak)) {
+		free(buf);
+	}
+
+	for (i = 0; i < TAP_PARAM(fails); i++) {
+		ok(0, "round %d fails", round);
+	}
+}
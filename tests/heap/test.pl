@@ -0,0 +1,14 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 3;
+
+for my $round (0, 1, 2) {
+	my $size = 10 ** ($round + 2);
+
+	ok(1, "round $round allocated $size B twice");
+}
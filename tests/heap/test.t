@@ -0,0 +1,83 @@
+#!/bin/sh
+
+echo '1..6'
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+perlstatus=$?
+
+./test 2> test.c.err > test.c.out
+cstatus=$?
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ] && [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 1 - output is identical'
+else
+	retval=1
+	echo 'not ok 1 - output is identical'
+	echo "# perlstatus = $perlstatus"
+	echo "#    cstatus = $cstatus"
+fi
+
+# Only the leaking round is reported, sizes of small buffers are rounded up
+# by the allocator, so just the leak is exact
+leak='^# Round 1: [0-9]* allocations, [0-9]* B allocated, peak [0-9]* B'
+leak="$leak, leaked 1000 B\$"
+
+if [ $(grep -c '^# Round ' test.c.err) -eq 1 ] && grep -q "$leak" test.c.err
+then
+	echo 'ok 2 - leaking round is reported'
+else
+	retval=1
+	echo 'not ok 2 - leaking round is reported'
+fi
+
+# Rounds are sorted by the peak, which has both buffers
+awk '
+	/^# Rounds with the largest heap usage:$/ { table = 1; next }
+	table && NF == 6 && $6 ~ /^[0-9]+$/ {
+		rounds = rounds " " $2
+		if ($5 < 2 * 10 ^ ($2 + 2) || $6 != ($2 == 1 ? 1000 : 0)) {
+			bad = 1
+		}
+	}
+	END { exit bad || rounds != " 2 1 0" }
+' test.c.err
+
+if [ $? -eq 0 ]; then
+	echo 'ok 3 - peaks of rounds are listed'
+else
+	retval=1
+	echo 'not ok 3 - peaks of rounds are listed'
+fi
+
+if grep -q '^# 1 rounds leaked 1000 B$' test.c.err; then
+	echo 'ok 4 - leaks are summed up'
+else
+	retval=1
+	echo 'not ok 4 - leaks are summed up'
+fi
+
+# Rounds of threads are tracked as well
+./test -j 2 2> test.c.err > /dev/null
+
+if grep -q "$leak" test.c.err && 
+   grep -q '^# 1 rounds leaked 1000 B$' test.c.err; then
+	echo 'ok 5 - leaks of threads are reported'
+else
+	retval=1
+	echo 'not ok 5 - leaks of threads are reported'
+fi
+
+# Failed repetitions are kept for the report, the round doesn't leak them
+./test --repeat 3 -p fails=20 -r 0 2> test.c.err > /dev/null
+
+if grep -q '^# Rounds with the largest heap usage:$' test.c.err && 
+   ! grep -q '^# Round 0: \|leaked [1-9]' test.c.err; then
+	echo "ok 6 - failed repetitions aren't leaks"
+else
+	retval=1
+	echo "not ok 6 - failed repetitions aren't leaks"
+fi
+
+exit $retval
@@ -0,0 +1,55 @@
+#!/bin/sh
+
+echo '1..6'
+
+rm -f test.history test.history.idx
+
+# Runs the test n times with the given options
+run()
+{
+	n=$1
+	shift
+	while [ $n -gt 0 ]; do
+		./test --bench-samples 5 --bench-time 100 \
+			--history test.history "$@" > /dev/null 2>&1 || 
+			return 1
+		n=$(($n - 1))
+	done
+}
+
+# Prints ok or not ok with the given description by the last status
+result()
+{
+	if [ $? -eq 0 ]; then
+		echo "ok $1"
+	else
+		retval=1
+		echo "not ok $1"
+	fi
+}
+
+run 4 && ../../src/tap-history test.history > test.out
+result '1 - runs are appended'
+grep -q '^copy \[round 0\]: 4 runs, ' test.out
+result '2 - history reports every run'
+
+# A deleted index is rebuilt from the history
+rm -f test.history.idx
+run 1 && [ -f test.history.idx ] &&
+	../../src/tap-history test.history > test.out &&
+	grep -q '^copy \[round 0\]: 5 runs, ' test.out
+result '3 - deleted index is rebuilt'
+
+# The copy is a thousand times bigger in later runs
+run 4 -p size=65536 && ../../src/tap-history test.history > test.out
+[ $? -eq 1 ] && grep -q '^    change at run 6 (' test.out
+result '4 - regression is reported'
+
+../../src/tap-history -n 5 test.history > test.out
+result '5 - older runs are ignored'
+
+../../src/tap-history test.missing > /dev/null 2>&1
+[ $? -eq 2 ]
+result '6 - missing history is an error'
+
+exit $retval
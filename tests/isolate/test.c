@@ -0,0 +1,60 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include "tap.h"
+
+/* Rounds, which crash or exit, fail the tests they didn't run and the
+   following rounds are executed normally */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(crash, int)
+	TAP_PARAM_FIELD(exit, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 3),
+	TAP_PARAMS_VALUES(.tap.plan = 3, .crash = 1),
+	TAP_PARAMS_VALUES(.tap.plan = 3, .exit = 1),
+	TAP_PARAMS_VALUES(.tap.plan = 3),
+)
+
+void tap_main(int round)
+{
+	ok(1, "first test of round %d", round);
+
+	if (TAP_PARAM(crash)) {
+		*(volatile int*)NULL = 0;
+	}
+
+	if (TAP_PARAM(exit)) {
+		exit(3);
+	}
+
+	ok(1, "second test of round %d", round);
+	ok(1, "third test of round %d", round);
+}
@@ -0,0 +1,21 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 12;
+
+my @died = ('', 'killed by SIGSEGV', 'exited with status 3', '');
+
+for (my $round = 0; $round < 4; $round++) {
+	ok(1, "first test of round $round");
+	if ($died[$round]) {
+		ok(0, "round $round $died[$round]");
+		ok(0, "round $round $died[$round]");
+	} else {
+		ok(1, "second test of round $round");
+		ok(1, "third test of round $round");
+	}
+}
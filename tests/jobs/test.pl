@@ -0,0 +1,16 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 15;
+
+for (my $round = 0; $round < 5; $round++) {
+	ok(1, "round $round");
+	ok($round != 2, "value of round $round");
+	SKIP: {
+		skip "skipped in round $round", 1;
+	}
+}
@@ -0,0 +1,57 @@
+#!/bin/sh
+
+echo '1..4'
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+perlstatus=$?
+
+./test -j 4 2> /dev/null > test.c.out
+cstatus=$?
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ]; then
+	echo 'ok 1 - output is identical'
+else
+	retval=1
+	echo 'not ok 1 - output is identical'
+fi
+
+if [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 2 - status code'
+else
+	retval=1
+	echo 'not ok 2 - status code'
+	echo "# perlstatus = $perlstatus"
+	echo "#    cstatus = $cstatus"
+fi
+
+# Round 3 finishes first, its bail out follows rounds 0 to 2
+./test -j 4 -p bail=4 2> /dev/null > test.c.out
+cstatus=$?
+
+if [ $cstatus -eq 255 ] && [ "`grep -c '^ok\|^not ok' test.c.out`" = 9 ] &&
+		tail -n 1 test.c.out | grep -q '^Bail out! round 3 at '; then
+	echo 'ok 3 - bail out of a job follows the preceding rounds'
+else
+	retval=1
+	echo 'not ok 3 - bail out of a job follows the preceding rounds'
+	echo "# cstatus = $cstatus"
+	sed 's/^/# /' test.c.out
+fi
+
+# Round 0 bails out last, the finished rounds after it aren't written
+./test -j 2 -p bail=1 2> /dev/null > test.c.out
+cstatus=$?
+
+if [ $cstatus -eq 255 ] && ! grep -q '^ok\|^not ok' test.c.out &&
+		tail -n 1 test.c.out | grep -q '^Bail out! round 0 at '; then
+	echo 'ok 4 - rounds after the bail out are dropped'
+else
+	retval=1
+	echo 'not ok 4 - rounds after the bail out are dropped'
+	echo "# cstatus = $cstatus"
+	sed 's/^/# /' test.c.out
+fi
+
+exit $retval
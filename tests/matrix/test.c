@@ -0,0 +1,55 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "tap.h"
+
+/* Rounds of the matrix are numbered in the mixed radix of the axes sizes,
+   the last axis changes the fastest */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(size, int)
+	TAP_PARAM_FIELD(threads, int)
+	TAP_PARAM_FIELD(data, const char *)
+	TAP_PARAM_FIELD(flags, int)
+)
+
+TAP_PARAMS_AXIS(size, 1, 16, 256);
+TAP_PARAMS_AXIS(threads, 1, 2);
+TAP_PARAMS_AXIS(data, "zero", "random");
+
+TAP_PARAMS_MATRIX(
+	.tap.plan = 2,
+	.flags = 42,
+)
+
+void tap_main(int round)
+{
+	ok(TAP_PARAM(size) == (round / 4 == 0 ? 1 : round / 4 == 1 ? 16 : 256),
+			"size of round %d", round);
+	ok(TAP_PARAM(threads) == round / 2 % 2 + 1 && 
+			TAP_PARAM(data)[0] == (round % 2 ? 'r' : 'z') &&
+			TAP_PARAM(flags) == 42, "values of round %d", round);
+}
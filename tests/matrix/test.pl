@@ -0,0 +1,13 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 12;
+
+for my $round (1 .. 5, 11) {
+	ok(1, "size of round $round");
+	ok(1, "values of round $round");
+}
@@ -0,0 +1,54 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "tap.h"
+
+/* Values given by -p override values of every round, but rounds read them
+   from a copy, values of the table stay the same */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(base, int)
+	TAP_PARAM_FIELD(name, const char *)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 3, .base = 1, .name = "first"),
+	TAP_PARAMS_VALUES(.tap.plan = 3, .base = 2, .name = "second"),
+	TAP_PARAMS_VALUES(.tap.plan = 3, .base = 3, .name = "third"),
+)
+
+static const char *names[] = {"first", "second", "third"};
+
+void tap_main(int round)
+{
+	ok(TAP_PARAM(base) == 7, "base of round %d is overridden", round);
+	ok(0 == strcmp(TAP_PARAM(name), names[round]), 
+			"name of round %d is kept", round);
+	ok(tap_params_values[round].base == round + 1, 
+			"values of round %d are not modified", round);
+}
@@ -0,0 +1,14 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 9;
+
+for (my $round = 0; $round < 3; $round++) {
+	ok(1, "base of round $round is overridden");
+	ok(1, "name of round $round is kept");
+	ok(1, "values of round $round are not modified");
+}
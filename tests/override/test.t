@@ -0,0 +1,33 @@
+#!/bin/sh
+
+echo '1..6'
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+perlstatus=$?
+
+# Rounds are executed sequentially, by threads and in forked processes
+n=0
+for args in "" "-j 2" "-f"; do
+	./test -p base=7 $args 2> /dev/null > test.c.out
+	cstatus=$?
+
+	diff -u test.pl.out test.c.out
+
+	if [ $? -eq 0 ]; then
+		echo "ok $((n += 1)) - output is identical ($args)"
+	else
+		retval=1
+		echo "not ok $((n += 1)) - output is identical ($args)"
+	fi
+
+	if [ $perlstatus -eq $cstatus ]; then
+		echo "ok $((n += 1)) - status code ($args)"
+	else
+		retval=1
+		echo "not ok $((n += 1)) - status code ($args)"
+		echo "# perlstatus = $perlstatus"
+		echo "#    cstatus = $cstatus"
+	fi
+done
+
+exit $retval
@@ -0,0 +1,64 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <sys/resource.h>
+
+#include "tap.h"
+
+/* Counts of hardware events are limited by ok_max_perf. Counters need a file
+   descriptor each, none is left with the nofile limit, so they can't be
+   opened and tests are skipped. Without the limit (-p nofile=0) counters may
+   or may not be available here, the tests are skipped or pass. */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(size, int)
+	TAP_PARAM_FIELD(nofile, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 3, .size = 64, .nofile = 3),
+)
+
+void tap_main(int round)
+{
+	struct rlimit limit = {TAP_PARAM(nofile), TAP_PARAM(nofile)};
+	char src[64], dst[64];
+
+	if (TAP_PARAM(nofile) && setrlimit(RLIMIT_NOFILE, &limit)) {
+		BAIL_OUT("Can't limit file descriptors");
+	}
+
+	memset(src, round, sizeof src);
+
+	TAP_BENCH("copy of %d bytes", TAP_PARAM(size)) {
+		memcpy(dst, src, TAP_PARAM(size));
+		tap_bench_clobber();
+	}
+
+	ok_max_perf(TAP_PERF_CYCLES, 1e9);
+	ok_max_perf(TAP_PERF_LLC_MISSES, 1e9, "copy doesn't miss much");
+}
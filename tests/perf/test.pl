@@ -0,0 +1,27 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 3;
+
+my $out = Test::More->builder->output;
+
+ok(1, "copy of 64 bytes");
+print $out <<END;
+  ---
+  name: copy of 64 bytes
+  line: 57
+  samples: 5
+  ...
+END
+
+SKIP: {
+	skip("cycles aren't counted", 1);
+}
+
+SKIP: {
+	skip("llc_misses aren't counted", 1);
+}
@@ -0,0 +1,37 @@
+#!/bin/sh
+
+echo '1..2'
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+perlstatus=$?
+
+./test --bench-samples 5 --bench-time 100 2> /dev/null > test.c.raw
+cstatus=$?
+
+# Durations and iterations of samples differ from run to run, the path of
+# the source depends on the build directory
+grep -v "^  [a-z0-9]*_ns: \|^  iterations: \|^  file: " test.c.raw \
+	> test.c.out
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ] && [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 1 - tests are skipped without counters'
+else
+	retval=1
+	echo 'not ok 1 - tests are skipped without counters'
+	echo "# perlstatus = $perlstatus"
+	echo "#    cstatus = $cstatus"
+fi
+
+# Counters may or may not be available here, the limits are never hit
+./test -p nofile=0 --bench-samples 5 --bench-time 100 > /dev/null 2>&1
+
+if [ $? -eq 0 ]; then
+	echo 'ok 2 - limits are kept'
+else
+	retval=1
+	echo 'not ok 2 - limits are kept'
+fi
+
+exit $retval
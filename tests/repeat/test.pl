@@ -0,0 +1,33 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 2;
+
+my $out = Test::More->builder->output;
+
+ok(1, "Round 0 passed 10 of 10 repetitions");
+print $out <<END;
+  ---
+  name: Round 0 passed 10 of 10 repetitions
+  repetitions: 10
+  failures: 0
+  flake_rate: 0.000
+  flake_rate_ci95: [0.000, 0.278]
+  ...
+END
+
+ok(0, "Round 1 passed 8 of 10 repetitions");
+print $out <<END;
+  ---
+  name: Round 1 passed 8 of 10 repetitions
+  severity: fail
+  repetitions: 10
+  failures: 2
+  flake_rate: 0.200
+  flake_rate_ci95: [0.057, 0.510]
+  ...
+END
@@ -0,0 +1,82 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "tap.h"
+
+/* Every round touches fresh pages and sleeps, so it has page faults and
+   context switches its limits are checked against. Counts differ from run to
+   run and test.t filters them out of --rusage reports. A byte per page is
+   written, the TAP output isn't counted. */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(pages, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 4, .pages = 64),
+	TAP_PARAMS_VALUES(.tap.plan = 4, .pages = 256),
+)
+
+void tap_main(int round)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	size_t size = TAP_PARAM(pages) * page;
+	char *mem;
+	int fd;
+
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, 
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		BAIL_OUT("Can't map %zu bytes", size);
+	}
+
+	memset(mem, round, size);
+	usleep(1000);
+	usleep(1000);
+
+	ok_max_faults(1000000, "round %d has a few faults", round);
+	ok_max_ctx_switches(1000000);
+
+	TODO ("Pages are touched and the round sleeps") {
+		ok_max_faults(TAP_PARAM(pages) / 2, 
+				"round %d doesn't touch pages", round);
+		ok_max_ctx_switches(1, "round %d doesn't sleep", round);
+	}
+
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0 || write(fd, mem, TAP_PARAM(pages)) != TAP_PARAM(pages)) {
+		BAIL_OUT("Can't write to /dev/null");
+	}
+	close(fd);
+
+	munmap(mem, size);
+}
@@ -0,0 +1,65 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+# With the 'rusage' argument failed tests have YAMLish blocks, counts are
+# replaced by N
+my $rusage = @ARGV && $ARGV[0] eq 'rusage';
+
+plan tests => 8;
+
+Test::More->builder->todo_output(\*STDERR);
+my $out = Test::More->builder->output;
+
+for my $round (0, 1) {
+	my $pages = $round ? 256 : 64;
+	my $half = $pages / 2;
+
+	ok(1, "round $round has a few faults");
+	ok(1, "At most 1000000 context switches");
+
+	TODO: {
+		local $TODO = "Pages are touched and the round sleeps";
+
+		ok(0, "round $round doesn't touch pages");
+		print $out <<END if $rusage;
+  ---
+  name: round $round doesn't touch pages
+  line: 70
+  severity: todo
+  actual: N
+  expected: <= $half
+  rusage:
+    user_us: N
+    sys_us: N
+    minor_faults: N
+    major_faults: N
+    voluntary_ctx_switches: N
+    involuntary_ctx_switches: N
+    max_rss_kb: N
+  ...
+END
+
+		ok(0, "round $round doesn't sleep");
+		print $out <<END if $rusage;
+  ---
+  name: round $round doesn't sleep
+  line: 72
+  severity: todo
+  actual: N
+  expected: <= 1
+  rusage:
+    user_us: N
+    sys_us: N
+    minor_faults: N
+    major_faults: N
+    voluntary_ctx_switches: N
+    involuntary_ctx_switches: N
+    max_rss_kb: N
+  ...
+END
+	}
+}
@@ -0,0 +1,75 @@
+#!/bin/sh
+
+echo '1..5'
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+perlstatus=$?
+
+./test 2> /dev/null > test.c.out
+cstatus=$?
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ] && [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 1 - limits are checked'
+else
+	retval=1
+	echo 'not ok 1 - limits are checked'
+	echo "# perlstatus = $perlstatus"
+	echo "#    cstatus = $cstatus"
+fi
+
+perl $srcdir/test.pl rusage 2> /dev/null > test.pl.out
+
+./test --rusage 2> test.c.err > test.c.raw
+cstatus=$?
+
+# Counts differ from run to run, the I/O isn't known everywhere and the path
+# of the source depends on the build directory
+grep -v "^  file: \|^    read_bytes: \|^    written_bytes: " test.c.raw | 
+	sed 's/^\(  actual\|    [a-z_]*\): [0-9]*$/\1: N/' > test.c.out
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ] && [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 2 - failed tests report the usage'
+else
+	retval=1
+	echo 'not ok 2 - failed tests report the usage'
+fi
+
+usage="user [0-9.]* ms, sys [0-9.]* ms, faults [0-9]* minor [0-9]* major"
+usage="$usage, context switches [0-9]* voluntary [0-9]* involuntary"
+usage="$usage, max RSS [0-9]* kB"
+
+if [ $(grep -c "^# Round [01]: $usage" test.c.err) -eq 2 ]; then
+	echo 'ok 3 - rounds report the usage'
+else
+	retval=1
+	echo 'not ok 3 - rounds report the usage'
+fi
+
+# The first round touches 64 pages
+if grep -q "^# Round 0: .*, faults \(6[4-9]\|[7-9][0-9]\) minor" test.c.err
+then
+	echo 'ok 4 - faults of the round are counted'
+else
+	retval=1
+	echo 'not ok 4 - faults of the round are counted'
+fi
+
+# Only the bytes written by rounds are counted, if the I/O is known
+written=ok
+if grep -q "^# Round [01]: .*, read [0-9]* B" test.c.err; then
+	grep -q "^# Round 0: .*, written 64 B$" test.c.err || written=fail
+	grep -q "^# Round 1: .*, written 256 B$" test.c.err || written=fail
+fi
+
+if [ $written = ok ]; then
+	echo "ok 5 - the output of the test isn't counted"
+else
+	retval=1
+	echo "not ok 5 - the output of the test isn't counted"
+fi
+
+exit $retval
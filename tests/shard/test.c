@@ -0,0 +1,51 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "tap.h"
+
+/* Shards select every round exactly once, tap-merge joins their output into
+   one stream */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(value, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 1),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 2),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 3),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 4),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 5),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 6),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 7),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .value = 8),
+)
+
+void tap_main(int round)
+{
+	ok(1, "round %d", round);
+	ok(TAP_PARAM(value) != 3, "value of round %d", round);
+}
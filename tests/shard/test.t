@@ -0,0 +1,52 @@
+#!/bin/sh
+
+echo '1..4'
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+
+./test --shard 1/2 2> /dev/null > test.1.out
+status1=$?
+./test --shard 2/2 2> /dev/null > test.2.out
+status2=$?
+
+# Every round is selected by exactly one shard
+cat test.1.out test.2.out | sed -n 's/^ok [0-9]* - round //p' | sort -n \
+	> test.rounds.out
+if seq 0 7 | diff -u - test.rounds.out; then
+	echo 'ok 1 - shards select every round once'
+else
+	retval=1
+	echo 'not ok 1 - shards select every round once'
+fi
+
+if [ $status1 -eq 1 ] && [ $status2 -eq 0 ]; then
+	echo 'ok 2 - status codes of shards'
+else
+	retval=1
+	echo 'not ok 2 - status codes of shards'
+	echo "# status1 = $status1"
+	echo "# status2 = $status2"
+fi
+
+# Tests are renumbered and plans of shards are summed
+../../src/tap-merge test.1.out test.2.out > test.c.out
+cstatus=$?
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ]; then
+	echo 'ok 3 - merged output is identical'
+else
+	retval=1
+	echo 'not ok 3 - merged output is identical'
+fi
+
+if [ $cstatus -eq 0 ]; then
+	echo 'ok 4 - status code of tap-merge'
+else
+	retval=1
+	echo 'not ok 4 - status code of tap-merge'
+	echo "#    cstatus = $cstatus"
+fi
+
+exit $retval
@@ -0,0 +1,70 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+
+#include "tap.h"
+
+/* Threads report results concurrently, test numbers must be gap-free and
+   tests of every thread must be numbered in the order they were run. The
+   last test of every thread fails, so failures are counted concurrently
+   too. */
+
+#define THREADS 8
+#define TESTS 500
+
+static void *results(void *arg)
+{
+	long thread = (long)arg;
+	int i;
+
+	for (i = 0; i < TESTS - 1; i++) {
+		ok(i >= 0, "thread %ld test %d", thread, i);
+	}
+	ok(i < 0, "thread %ld test %d", thread, i);
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	pthread_t threads[THREADS];
+	long i;
+
+	plan_tests(THREADS * TESTS);
+
+	for (i = 0; i < THREADS; i++) {
+		if (pthread_create(&threads[i], NULL, results, (void *)i)) {
+			BAIL_OUT("Can't create a thread");
+		}
+	}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	return exit_status();
+}
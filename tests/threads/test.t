@@ -0,0 +1,50 @@
+#!/bin/sh
+
+echo '1..4'
+
+./test 2> test.c.err > test.c.out
+cstatus=$?
+
+# Results are numbered 1..4000 in the order they are written
+sed -n 's/^\(not \)\{0,1\}ok \([0-9]*\) - .*/\2/p' test.c.out \
+	> test.numbers.out
+if seq 1 4000 | diff -q - test.numbers.out > /dev/null; then
+	echo 'ok 1 - numbers are gap-free and ordered'
+else
+	retval=1
+	echo 'not ok 1 - numbers are gap-free and ordered'
+fi
+
+# Every thread has its tests 0..499 in the order they were run
+order=0
+for thread in 0 1 2 3 4 5 6 7; do
+	sed -n "s/^\(not \)\{0,1\}ok [0-9]* - thread $thread test //p" \
+		test.c.out > test.numbers.out
+	seq 0 499 | diff -q - test.numbers.out > /dev/null || order=1
+done
+
+if [ $order -eq 0 ]; then
+	echo 'ok 2 - tests of threads are in order'
+else
+	retval=1
+	echo 'not ok 2 - tests of threads are in order'
+fi
+
+# The last test of every thread fails
+if [ $(grep -c '^not ok [0-9]* - thread [0-7] test 499$' test.c.out) -eq 8 ] \
+   && grep -q '^# Looks like you failed 8 tests of 4000\.$' test.c.err; then
+	echo 'ok 3 - failures are counted'
+else
+	retval=1
+	echo 'not ok 3 - failures are counted'
+fi
+
+if [ $cstatus -eq 8 ]; then
+	echo 'ok 4 - status code'
+else
+	retval=1
+	echo 'not ok 4 - status code'
+	echo "#    cstatus = $cstatus"
+fi
+
+exit $retval
@@ -0,0 +1,58 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+
+#include "tap.h"
+
+/* Rounds sleep for 5, 10, ... 30 ms, so the slowest ones are the last ones.
+   Every round has a passed test and a failed TODO test, durations of tests
+   are in their YAMLish blocks with --timing. Durations differ from run to run
+   and test.t filters them out. */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(sleep_ms, int)
+)
+
+TAP_PARAMS_VALUES_ARRAY(
+	TAP_PARAMS_VALUES(.tap.plan = 2, .sleep_ms = 5),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .sleep_ms = 10),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .sleep_ms = 15),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .sleep_ms = 20),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .sleep_ms = 25),
+	TAP_PARAMS_VALUES(.tap.plan = 2, .sleep_ms = 30),
+)
+
+void tap_main(int round)
+{
+	usleep(TAP_PARAM(sleep_ms) * 1000);
+
+	ok(round >= 0, "round %d slept", round);
+
+	TODO ("Durations are reported") {
+		ok(round < 0, "round %d didn't sleep", round);
+	}
+}
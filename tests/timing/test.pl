@@ -0,0 +1,43 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+# With the 'pass' argument passed tests have YAMLish blocks too, durations
+# are replaced by N
+my $pass = @ARGV && $ARGV[0] eq 'pass';
+
+plan tests => 12;
+
+Test::More->builder->todo_output(\*STDERR);
+my $out = Test::More->builder->output;
+
+for my $round (0 .. 5) {
+	ok(1, "round $round slept");
+	print $out <<END if $pass;
+  ---
+  name: round $round slept
+  line: 53
+  duration_ns: N
+  since_start_ns: N
+  ...
+END
+
+	TODO: {
+		local $TODO = "Durations are reported";
+
+		ok(0, "round $round didn't sleep");
+		print $out <<END;
+  ---
+  name: round $round didn't sleep
+  message: Condition 'round < 0' evaluated to false
+  line: 56
+  severity: todo
+  duration_ns: N
+  since_start_ns: N
+  ...
+END
+	}
+}
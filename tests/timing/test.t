@@ -0,0 +1,90 @@
+#!/bin/sh
+
+echo '1..5'
+
+# Durations differ from run to run, the path of the source depends on the
+# build directory
+filter()
+{
+	grep -v "^  file: " test.c.raw | 
+		sed 's/^\(  [a-z_]*_ns\): [0-9]*$/\1: N/' > test.c.out
+}
+
+perl $srcdir/test.pl 2> /dev/null > test.pl.out
+perlstatus=$?
+
+./test --timing 2> /dev/null > test.c.raw
+cstatus=$?
+filter
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ] && [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 1 - failed tests have durations'
+else
+	retval=1
+	echo 'not ok 1 - failed tests have durations'
+	echo "# perlstatus = $perlstatus"
+	echo "#    cstatus = $cstatus"
+fi
+
+perl $srcdir/test.pl pass 2> /dev/null > test.pl.out
+
+./test --timing=pass 2> /dev/null > test.c.raw
+cstatus=$?
+filter
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ] && [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 2 - passed tests have durations with --timing=pass'
+else
+	retval=1
+	echo 'not ok 2 - passed tests have durations with --timing=pass'
+fi
+
+# A passed test comes after the sleep of its round, which started before 
+# the test run
+awk '
+	/^ok [0-9]* - round [0-5] slept$/ { round = $5 }
+	/^  duration_ns: / { duration = $2 }
+	/^  since_start_ns: / && round != "" {
+		if (duration < (round + 1) * 5000000 || $2 < duration) {
+			bad = 1
+		}
+		round = ""
+	}
+	END { exit bad }
+' test.c.raw
+
+if [ $? -eq 0 ]; then
+	echo 'ok 3 - durations include the sleep'
+else
+	retval=1
+	echo 'not ok 3 - durations include the sleep'
+fi
+
+./test --slowest 3 2> test.c.err > /dev/null
+
+sed -n '/^# Slowest rounds:$/,$p' test.c.err > test.c.out
+if [ "$(sed -n 2p test.c.out)" = "#        round  duration [ms]" ] &&
+   [ "$(sed -n '3,$s/^# *\([0-9]*\) *[0-9.]*$/\1/p' test.c.out | 
+	tr '\n' ' ')" = "5 4 3 " ]; then
+	echo 'ok 4 - the slowest rounds are listed'
+else
+	retval=1
+	echo 'not ok 4 - the slowest rounds are listed'
+fi
+
+# The table has every round, if there are less rounds than its rows
+./test --slowest 10 2> test.c.err > /dev/null
+
+if [ $(sed -n '/^# Slowest rounds:$/,$p' test.c.err | 
+	grep -c '^# *[0-5] *[0-9.]*$') -eq 6 ]; then
+	echo 'ok 5 - short table lists every round'
+else
+	retval=1
+	echo 'not ok 5 - short table lists every round'
+fi
+
+exit $retval
@@ -0,0 +1,66 @@
+/*-
+ * Copyright (c) 2013 Petr Malat
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+
+#include "tap.h"
+
+/* With -j rounds are scheduled longest first by their durations in the 
+   timings file of the previous run, without it they are dealt in their 
+   order. A slow round doesn't hold back the rounds after it, only their
+   output waits for it */
+
+TAP_PARAMS_DEFINITION(
+	TAP_PARAM_FIELD(a, int)
+	TAP_PARAM_FIELD(b, int)
+	TAP_PARAM_FIELD(slow, int)
+	TAP_PARAM_FIELD(delay, int)
+)
+
+TAP_PARAMS_AXIS(a, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 
+		10, 11, 12, 13, 14, 15, 16, 17, 18, 19);
+TAP_PARAMS_AXIS(b, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+
+TAP_PARAMS_MATRIX(
+	.tap.plan = 1,
+	.slow = 199,
+	.delay = 200,
+)
+
+static int started, finished;
+
+void tap_main(int round)
+{
+	int n = __atomic_fetch_add(&started, 1, __ATOMIC_RELAXED);
+
+	if (round == TAP_PARAM(slow)) {
+		usleep(TAP_PARAM(delay) * 1000);
+	}
+
+	ok(TAP_PARAM(a) * 10 + TAP_PARAM(b) == round, 
+			"round %d started %d, %d finished before", round, n, 
+			__atomic_fetch_add(&finished, 1, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,67 @@
+#!/bin/sh
+
+echo '1..6'
+
+rm -f test.timings spill.timings
+
+# Without the timings file rounds are dealt to the jobs in their order, 
+# the slow last round is one of the last ones started
+./test -j 2 -T test.timings --timing > test.c.out 2>&1
+
+if grep -q '^ok 200 - round 199 started \([2-9]\|[1-9][0-9]*\),' test.c.out
+then
+	echo 'ok 1 - rounds start in their order without timings'
+else
+	retval=1
+	echo 'not ok 1 - rounds start in their order without timings'
+	grep '^ok 200 ' test.c.out | sed 's/^/# /'
+fi
+
+if grep -q '^# Parallel efficiency [0-9.]*% (2 workers busy ' test.c.out; then
+	echo 'ok 2 - parallel efficiency is reported'
+else
+	retval=1
+	echo 'not ok 2 - parallel efficiency is reported'
+fi
+
+if [ "`head -n 1 test.timings`" = 'rounds 200' ] && 
+		[ "`grep -c '^[0-9]* [1-9][0-9]*$' test.timings`" = 200 ]; then
+	echo 'ok 3 - durations of rounds are saved'
+else
+	retval=1
+	echo 'not ok 3 - durations of rounds are saved'
+fi
+
+# The slow last round goes first, once its duration is known
+./test -j 2 -T test.timings --timing > test.c.out 2>&1
+
+if grep -q '^ok 200 - round 199 started [01],' test.c.out; then
+	echo 'ok 4 - the longest round starts first'
+else
+	retval=1
+	echo 'not ok 4 - the longest round starts first'
+	grep '^ok 200 ' test.c.out | sed 's/^/# /'
+fi
+
+# The other rounds finish while the first one sleeps
+./test -j 2 -p slow=0 -T spill.timings > test.c.out 2>&1
+cstatus=$?
+
+if grep -q '^ok 1 - round 0 started [01], 199 finished before' test.c.out
+then
+	echo 'ok 5 - rounds run ahead of a slow round'
+else
+	retval=1
+	echo 'not ok 5 - rounds run ahead of a slow round'
+	grep '^ok 1 ' test.c.out | sed 's/^/# /'
+fi
+
+if [ $cstatus -eq 0 ] && [ "`awk '/^ok/ && $2 == n + 1 && $5 == n { n++ }
+		END { print n }' test.c.out`" = 200 ]; then
+	echo 'ok 6 - rounds written ahead of the window keep their order'
+else
+	retval=1
+	echo 'not ok 6 - rounds written ahead of the window keep their order'
+fi
+
+exit $retval
@@ -0,0 +1,29 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+use Test::More;
+
+plan tests => 3;
+
+diag('Starting round 0');
+diag(' base: 1');
+diag('base2: 2');
+diag(' size: sizeof(int) * 2');
+diag(' name: "a)b"');
+ok(1, 'round 0');
+
+diag('Starting round 1');
+diag(' base: 3');
+diag('base2: 0');
+diag(' size: (1 + 2) * sizeof(short)');
+diag(' name: 0');
+ok(1, 'round 1');
+
+diag('Starting round 2');
+diag(' base: 0');
+diag('base2: 4');
+diag(' size: 0');
+diag(' name: 0');
+ok(1, 'round 2');
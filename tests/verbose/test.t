@@ -0,0 +1,31 @@
+#!/bin/sh
+
+echo '1..2'
+
+perl $srcdir/test.pl > test.pl.out 2>&1
+perlstatus=$?
+
+# Usage of rounds differs from run to run
+./test -v > test.c.raw 2>&1
+cstatus=$?
+grep -v '^# Round ' test.c.raw > test.c.out
+
+diff -u test.pl.out test.c.out
+
+if [ $? -eq 0 ]; then
+	echo 'ok 1 - output is identical'
+else
+	retval=1
+	echo 'not ok 1 - output is identical'
+fi
+
+if [ $perlstatus -eq $cstatus ]; then
+	echo 'ok 2 - status code'
+else
+	retval=1
+	echo 'not ok 2 - status code'
+	echo "# perlstatus = $perlstatus"
+	echo "#    cstatus = $cstatus"
+fi
+
+exit $retval